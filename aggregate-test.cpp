@@ -0,0 +1,192 @@
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "avlbst.h"
+
+using namespace std;
+
+// Concatenation is associative but not commutative, so it checks the key order.
+struct ConcatAggregate : public NoRangeUpdates<char>
+{
+    typedef string type;
+    static const bool enabled = true;
+    static type identity() { return string(); }
+    static type lift(const int&, const char& value) { return string(1, value); }
+    static type combine(const type& a, const type& b) { return a + b; }
+};
+
+void test1(const char* msg)
+{
+    // random inserts, updates and erases, checked against brute force sums
+    AVLTree<int, long, SumAggregate<long> > tree;
+    map<int, long> model;
+    srand(31);
+    bool ok = true;
+    for (int i = 0; i < 20000 && ok; ++i) {
+        int key = rand() % 500;
+        if (rand() % 3 == 0) {
+            tree.erase(key);
+            model.erase(key);
+        }
+        else {
+            long value = rand() % 1000 - 500;
+            tree.insert(make_pair(key, value));
+            model[key] = value;
+        }
+        int lo = rand() % 520 - 10;
+        int hi = lo + rand() % 200;
+        long expected = 0;
+        for (map<int, long>::iterator it = model.lower_bound(lo); it != model.end() && it->first <= hi; ++it) {
+            expected += it->second;
+        }
+        ok = (tree.aggregate(lo, hi) == expected);
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    AVLTree<int, int, MinAggregate<int> > mins;
+    AVLTree<int, int, MaxAggregate<int> > maxes;
+    for (int i = 0; i < 1000; ++i) {
+        int value = (i * 7919) % 1000;
+        mins.insert(make_pair(i, value));
+        maxes.insert(make_pair(i, value));
+    }
+    int lo = 1000, hi = -1;
+    for (int i = 100; i <= 200; ++i) {
+        int value = (i * 7919) % 1000;
+        lo = min(lo, value);
+        hi = max(hi, value);
+    }
+    cout << msg << ": " << (mins.aggregate(100, 200) == lo && maxes.aggregate(100, 200) == hi
+            && mins.aggregate(2000, 3000) == MinAggregate<int>::identity()) << endl;
+}
+
+void test3(const char* msg)
+{
+    AVLTree<int, char, ConcatAggregate> tree;
+    for (int i = 25; i >= 0; --i) {
+        tree.insert(make_pair(i, (char)('a' + i)));
+    }
+    tree.erase(3);
+    tree.insert(make_pair(4, 'E'));
+    cout << msg << ": " << (tree.aggregate(0, 25) == "abcEfghijklmnopqrstuvwxyz"
+            && tree.aggregate(2, 6) == "cEfg" && tree.aggregate(6, 2) == "") << endl;
+}
+
+void test4(const char* msg)
+{
+    AVLTree<string, int, CountAggregate<int> > tree;
+    tree.insert(make_pair(string("apple"), 1));
+    tree.insert(make_pair(string("banana"), 2));
+    tree.insert(make_pair(string("cherry"), 3));
+    tree.insert(make_pair(string("date"), 4));
+    tree.insert(make_pair(string("banana"), 5));
+    cout << msg << ": " << (tree.aggregate("b", "d") == 2 && tree.aggregate("a", "z") == 4) << endl;
+}
+
+void test5(const char* msg)
+{
+    // range adds mixed with inserts, erases and point reads, checked against a map
+    AVLTree<int, long, RangeAddAggregate<long> > tree;
+    map<int, long> model;
+    srand(32);
+    bool ok = true;
+    for (int i = 0; i < 20000 && ok; ++i) {
+        int key = rand() % 500;
+        int lo = rand() % 520 - 10;
+        int hi = lo + rand() % 200;
+        int op = rand() % 4;
+        if (op == 0) {
+            tree.erase(key);
+            model.erase(key);
+        }
+        else if (op == 1) {
+            long value = rand() % 1000;
+            tree.insert(make_pair(key, value));
+            model[key] = value;
+        }
+        else if (op == 2) {
+            long delta = rand() % 21 - 10;
+            tree.updateRange(lo, hi, delta);
+            for (map<int, long>::iterator it = model.lower_bound(lo); it != model.end() && it->first <= hi; ++it) {
+                it->second += delta;
+            }
+        }
+        else {
+            AVLTree<int, long, RangeAddAggregate<long> >::iterator it = tree.find(key);
+            ok = (it == tree.end()) ? (model.count(key) == 0) : (model.count(key) == 1 && it->second == model[key]);
+        }
+
+        RangeAddAggregate<long>::type expected = RangeAddAggregate<long>::identity();
+        for (map<int, long>::iterator it = model.lower_bound(lo); it != model.end() && it->first <= hi; ++it) {
+            expected = RangeAddAggregate<long>::combine(expected, RangeAddAggregate<long>::lift(it->first, it->second));
+        }
+        RangeAddAggregate<long>::type actual = tree.aggregate(lo, hi);
+        ok = ok && actual.sum == expected.sum && actual.min == expected.min
+                && actual.max == expected.max && actual.count == expected.count;
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test6(const char* msg)
+{
+    // iteration sees every pending update
+    AVLTree<int, int, RangeAddAggregate<int> > tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, 0));
+    }
+    for (int i = 0; i < 100; ++i) {
+        tree.updateRange(i, 99, 1);
+    }
+    bool ok = true;
+    int count = 0;
+    for (AVLTree<int, int, RangeAddAggregate<int> >::iterator it = tree.begin(); it != tree.end(); ++it) {
+        ok = ok && it->second == it->first + 1;
+        ++count;
+    }
+    tree.updateRange(50, 59, 100);
+    AVLTree<int, int, RangeAddAggregate<int> >::iterator it = tree.lowerBound(55);
+    cout << msg << ": " << (ok && count == 100 && it->second == 156 && (++it)->second == 157) << endl;
+}
+
+void test7(const char* msg)
+{
+    // lookups through a BinarySearchTree reference see pending range updates too
+    AVLTree<int, int, RangeAddAggregate<int> > tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, 0));
+    }
+    BinarySearchTree<int, int>& base = tree;
+    tree.updateRange(0, 99, 5);
+    bool ok = base.find(37)->second == 5;
+    tree.updateRange(0, 49, 1);
+    ok = ok && base.find(10, base.find(37))->second == 6 && base.lowerBound(48)->second == 6;
+    tree.updateRange(50, 99, 2);
+    vector<int> keys;
+    keys.push_back(20);
+    keys.push_back(80);
+    vector<BinarySearchTree<int, int>::iterator> found;
+    base.findMany(keys, found);
+    ok = ok && found[0]->second == 6 && found[1]->second == 7;
+    tree.updateRange(0, 99, 1);
+    int sum = 0;
+    for (BinarySearchTree<int, int>::iterator it = base.begin(); it != base.end(); ++it) {
+        sum += it->second;
+    }
+    cout << msg << ": " << (ok && sum == 50 * 7 + 50 * 8) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+    test4("Test4");
+    test5("Test5");
+    test6("Test6");
+    test7("Test7");
+}
@@ -0,0 +1,99 @@
+#include <cstddef>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include "avlbst.h"
+
+using namespace std;
+
+// Counts live objects and bytes, and checks every deallocation matches its allocation.
+size_t liveBytes = 0;
+size_t liveObjects = 0;
+
+template <typename T>
+struct CountingAllocator
+{
+    typedef T value_type;
+
+    CountingAllocator() {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        liveBytes += n * sizeof(T);
+        liveObjects += n;
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n)
+    {
+        liveBytes -= n * sizeof(T);
+        liveObjects -= n;
+        ::operator delete(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) { return false; }
+
+void test1(const char* msg)
+{
+    bool ok;
+    {
+        AVLTree<int, int, NoAggregate<int>, CountingAllocator<pair<int, int> > > tree;
+        for (int i = 0; i < 1000; ++i) {
+            tree.insert(make_pair(i, i));
+        }
+        tree.insert(make_pair(5, 50)); // an update allocates nothing
+        ok = liveObjects == 1000 && liveBytes == 1000 * sizeof(AVLNode<int, int>);
+        for (int i = 0; i < 1000; i += 2) {
+            tree.erase(i);
+        }
+        ok = ok && liveObjects == 500 && tree.validate();
+    }
+    cout << msg << ": " << (ok && liveObjects == 0 && liveBytes == 0) << endl;
+}
+
+void test2(const char* msg)
+{
+    bool ok;
+    {
+        BinarySearchTree<int, int, CountingAllocator<pair<int, int> > > tree;
+        tree.insert(make_pair(2, 2));
+        tree.insert(make_pair(1, 1));
+        tree.insert(make_pair(3, 3));
+        tree.insert(make_pair(1, 10)); // duplicate keys update in place
+        ok = liveObjects == 3 && liveBytes == 3 * sizeof(Node<int, int>) && tree.find(1)->second == 10;
+    }
+    cout << msg << ": " << (ok && liveObjects == 0) << endl;
+}
+
+void test3(const char* msg)
+{
+    // every node comes out of the arena, which is released in one go
+    char arena[1 << 16];
+    pmr::monotonic_buffer_resource resource(arena, sizeof(arena), pmr::null_memory_resource());
+    bool ok = true;
+    {
+        PmrAVLTree<int, string> tree(&resource);
+        for (int i = 0; i < 200; ++i) {
+            tree.insert(make_pair(i, string("v")));
+        }
+        PmrBinarySearchTree<int, int> plain(&resource);
+        plain.insert(make_pair(1, 1));
+        ok = tree.find(199)->second == "v" && plain.find(1)->second == 1 && tree.validate();
+        ok = ok && tree.get_allocator().resource() == &resource;
+    }
+    resource.release();
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+}
@@ -1,22 +1,157 @@
-ifndef AVLBST_H
+#ifndef AVLBST_H
 #define AVLBST_H
 
 #include <iostream>
 #include <cstdlib>
 #include <string>
+#include <limits>
 #include "bst.h"
 
+/**
+* Aggregate policies for AVLTree. A policy is a monoid over Value: type is the summary
+* kept in every node, identity() the neutral summary, lift(key, value) the summary of a
+* single item and combine(a, b) the summary of a followed by b. combine must be associative
+* but need not be commutative; summaries are always combined in key order.
+*
+* NoAggregate is the default. Its summary is empty and enabled is false, so a plain
+* AVLTree does no extra work on updates.
+*
+* A policy that supports AVLTree::updateRange also defines a tag (a pending update),
+* with lazy = true, noTag(), hasTag(t), applyToValue(value, t), applyToSummary(summary,
+* t) and composeTag(pending, newer), which folds a newer tag into a pending one.
+* Policies without range updates inherit the no-op versions from NoRangeUpdates.
+*/
+template <typename Value>
+struct NoRangeUpdates
+{
+    struct tag {};
+    static const bool lazy = false;
+    static tag noTag() { return tag(); }
+    static bool hasTag(const tag&) { return false; }
+    static void applyToValue(Value&, const tag&) {}
+    template <typename Summary>
+    static void applyToSummary(Summary&, const tag&) {}
+    static void composeTag(tag&, const tag&) {}
+};
+
+template <typename Value>
+struct NoAggregate : public NoRangeUpdates<Value>
+{
+    struct type {};
+    static const bool enabled = false;
+    static type identity() { return type(); }
+    template <typename Key>
+    static type lift(const Key&, const Value&) { return type(); }
+    static type combine(const type&, const type&) { return type(); }
+};
+
+template <typename Value>
+struct SumAggregate : public NoRangeUpdates<Value>
+{
+    typedef Value type;
+    static const bool enabled = true;
+    static type identity() { return Value(); }
+    template <typename Key>
+    static type lift(const Key&, const Value& value) { return value; }
+    static type combine(const type& a, const type& b) { return a + b; }
+};
+
+template <typename Value>
+struct MinAggregate : public NoRangeUpdates<Value>
+{
+    typedef Value type;
+    static const bool enabled = true;
+    static type identity() { return std::numeric_limits<Value>::max(); }
+    template <typename Key>
+    static type lift(const Key&, const Value& value) { return value; }
+    static type combine(const type& a, const type& b) { return (b < a) ? b : a; }
+};
+
+template <typename Value>
+struct MaxAggregate : public NoRangeUpdates<Value>
+{
+    typedef Value type;
+    static const bool enabled = true;
+    static type identity() { return std::numeric_limits<Value>::lowest(); }
+    template <typename Key>
+    static type lift(const Key&, const Value& value) { return value; }
+    static type combine(const type& a, const type& b) { return (a < b) ? b : a; }
+};
+
+template <typename Value>
+struct CountAggregate : public NoRangeUpdates<Value>
+{
+    typedef size_t type;
+    static const bool enabled = true;
+    static type identity() { return 0; }
+    template <typename Key>
+    static type lift(const Key&, const Value&) { return 1; }
+    static type combine(const type& a, const type& b) { return a + b; }
+};
+
+/**
+* Sum, minimum, maximum and count of a range, with "add delta to every value in [lo, hi]"
+* range updates. The tag is the delta still to be added below a node.
+*/
+template <typename Value>
+struct RangeAddAggregate
+{
+    struct type
+    {
+        Value sum;
+        Value min;
+        Value max;
+        size_t count;
+    };
+    static const bool enabled = true;
+    static type identity()
+    {
+        type summary = { Value(), std::numeric_limits<Value>::max(), std::numeric_limits<Value>::lowest(), 0 };
+        return summary;
+    }
+    template <typename Key>
+    static type lift(const Key&, const Value& value)
+    {
+        type summary = { value, value, value, 1 };
+        return summary;
+    }
+    static type combine(const type& a, const type& b)
+    {
+        type summary = { a.sum + b.sum, (b.min < a.min) ? b.min : a.min, (a.max < b.max) ? b.max : a.max, a.count + b.count };
+        return summary;
+    }
+
+    typedef Value tag;
+    static const bool lazy = true;
+    static tag noTag() { return Value(); }
+    static bool hasTag(const tag& delta) { return !(delta == Value()); }
+    static void applyToValue(Value& value, const tag& delta) { value += delta; }
+    static void applyToSummary(type& summary, const tag& delta)
+    {
+        if (summary.count != 0) {
+            summary.sum += delta * (Value)summary.count;
+            summary.min += delta;
+            summary.max += delta;
+        }
+    }
+    static void composeTag(tag& pending, const tag& delta) { pending += delta; }
+};
+
 /**
 * A special kind of node for an AVL tree, which adds the balance as a data member, plus
 * other additional helper functions. You do NOT need to implement any functionality or
 * add additional data members or helper functions.
+*
+* Each node also caches the Aggregate summary of its subtree, and, for policies with range
+* updates, a tag: an update that has been applied to this node's value and summary but
+* not yet to its children.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Aggregate = NoAggregate<Value> >
 class AVLNode : public Node<Key, Value>
 {
 public:
     // Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Aggregate>* parent);
     virtual ~AVLNode();
 
     // Getter/setter for the node's height.
@@ -24,15 +159,38 @@ public:
     void setBalance (char balance);
     void updateBalance(char diff);
 
+    // The Aggregate summary of the subtree rooted at this node.
+    const typename Aggregate::type& getSummary() const;
+    // Recomputes this node's summary from its value and its children's summaries.
+    void updateSummary();
+    // Recomputes the summaries of this node and all of its ancestors.
+    void updateSummaries();
+
+    // Applies a range update to this whole subtree: the node's own value and summary
+    // change now, the children receive it on the next pushTag().
+    void applyTag(const typename Aggregate::tag& tag);
+    // Hands the pending tag down to the children.
+    void pushTag();
+
+    // Sets the value and refreshes the summaries that depend on it.
+    virtual void setValue(const Value& value) override;
+    // Tombstone flag for lazy erase. An erased node adds nothing to the summaries; the
+    // caller refreshes them with updateSummaries().
+    virtual bool isErased() const override final;
+    void setErased(bool erased);
+
     // Getters for parent, left, and right. These need to be redefined since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    virtual AVLNode<Key, Value, Aggregate>* getParent() const override;
+    virtual AVLNode<Key, Value, Aggregate>* getLeft() const override;
+    virtual AVLNode<Key, Value, Aggregate>* getRight() const override;
 
 protected:
     char balance_;
+    bool erased_;
+    typename Aggregate::type summary_;
+    typename Aggregate::tag tag_;
 };
 
 /*
@@ -44,10 +202,13 @@ Begin implementations for the AVLNode class.
 /**
 * Constructor for an AVLNode. Nodes are initialized with a balance of 0.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+template<typename Key, typename Value, typename Aggregate>
+AVLNode<Key, Value, Aggregate>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Aggregate>* parent)
     : Node<Key, Value>(key, value, parent),
-      balance_(0)
+      balance_(0),
+      erased_(false),
+      summary_(Aggregate::lift(key, value)),
+      tag_(Aggregate::noTag())
 {
 
 }
@@ -55,8 +216,8 @@ AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Va
 /**
 * Destructor.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>::~AVLNode()
+template<typename Key, typename Value, typename Aggregate>
+AVLNode<Key, Value, Aggregate>::~AVLNode()
 {
 
 }
@@ -64,8 +225,8 @@ AVLNode<Key, Value>::~AVLNode()
 /**
 * A getter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-char AVLNode<Key, Value>::getBalance() const
+template<typename Key, typename Value, typename Aggregate>
+char AVLNode<Key, Value, Aggregate>::getBalance() const
 {
     return balance_;
 }
@@ -73,8 +234,8 @@ char AVLNode<Key, Value>::getBalance() const
 /**
 * A setter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::setBalance(char balance)
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::setBalance(char balance)
 {
     balance_ = balance;
 }
@@ -82,37 +243,136 @@ void AVLNode<Key, Value>::setBalance(char balance)
 /**
 * Adds diff to the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::updateBalance(char diff)
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::updateBalance(char diff)
 {
     balance_ += diff;
 }
 
+/**
+* A getter for the cached summary of the subtree.
+*/
+template<typename Key, typename Value, typename Aggregate>
+const typename Aggregate::type& AVLNode<Key, Value, Aggregate>::getSummary() const
+{
+    return summary_;
+}
+
+/**
+* Combines left summary, own value (unless erased) and right summary, in key order.
+* Assumes the children's summaries are up to date and this node has no pending tag.
+*/
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::updateSummary()
+{
+    if (!Aggregate::enabled) {
+        return;
+    }
+    typename Aggregate::type summary = erased_ ? Aggregate::identity() : Aggregate::lift(this->getKey(), this->getValue());
+    if (getLeft() != NULL) {
+        summary = Aggregate::combine(getLeft()->summary_, summary);
+    }
+    if (getRight() != NULL) {
+        summary = Aggregate::combine(summary, getRight()->summary_);
+    }
+    summary_ = summary;
+}
+
+/**
+* Walks up to the root recomputing summaries. O(log n) in a balanced tree.
+*/
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::updateSummaries()
+{
+    if (!Aggregate::enabled) {
+        return;
+    }
+    for (AVLNode<Key, Value, Aggregate>* n = this; n != NULL; n = n->getParent()) {
+        n->updateSummary();
+    }
+}
+
+/**
+* Updates the value and summary in place and queues the tag for the children.
+*/
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::applyTag(const typename Aggregate::tag& tag)
+{
+    Aggregate::applyToValue(this->mItem.second, tag);
+    Aggregate::applyToSummary(summary_, tag);
+    Aggregate::composeTag(tag_, tag);
+}
+
+/**
+* Pushes the pending tag one level down. Called on every node a descent passes through,
+* so the node's children are exact before they are read, moved or recombined.
+*/
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::pushTag()
+{
+    if (!Aggregate::lazy || !Aggregate::hasTag(tag_)) {
+        return;
+    }
+    if (getLeft() != NULL) {
+        getLeft()->applyTag(tag_);
+    }
+    if (getRight() != NULL) {
+        getRight()->applyTag(tag_);
+    }
+    tag_ = Aggregate::noTag();
+}
+
+/**
+* Setter for the value. Every ancestor's summary covers this value, so they are all
+* refreshed.
+*/
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::setValue(const Value& value)
+{
+    Node<Key, Value>::setValue(value);
+    updateSummaries();
+}
+
+/**
+* Getter and setter for the tombstone flag.
+*/
+template<typename Key, typename Value, typename Aggregate>
+bool AVLNode<Key, Value, Aggregate>::isErased() const
+{
+    return erased_;
+}
+
+template<typename Key, typename Value, typename Aggregate>
+void AVLNode<Key, Value, Aggregate>::setErased(bool erased)
+{
+    erased_ = erased;
+}
+
 /**
 * Getter function for the parent. Used since the node inherits from a base node.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLNode<Key, Value>::getParent() const
+template<typename Key, typename Value, typename Aggregate>
+AVLNode<Key, Value, Aggregate>* AVLNode<Key, Value, Aggregate>::getParent() const
 {
-    return static_cast<AVLNode<Key,Value>*>(this->mParent);
+    return static_cast<AVLNode<Key, Value, Aggregate>*>(this->mParent);
 }
 
 /**
 * Getter function for the left child. Used since the node inherits from a base node.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLNode<Key, Value>::getLeft() const
+template<typename Key, typename Value, typename Aggregate>
+AVLNode<Key, Value, Aggregate>* AVLNode<Key, Value, Aggregate>::getLeft() const
 {
-    return static_cast<AVLNode<Key,Value>*>(this->mLeft);
+    return static_cast<AVLNode<Key, Value, Aggregate>*>(this->mLeft);
 }
 
 /**
 * Getter function for the right child. Used since the node inherits from a base node.
 */
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLNode<Key, Value>::getRight() const
+template<typename Key, typename Value, typename Aggregate>
+AVLNode<Key, Value, Aggregate>* AVLNode<Key, Value, Aggregate>::getRight() const
 {
-    return static_cast<AVLNode<Key,Value>*>(this->mRight);
+    return static_cast<AVLNode<Key, Value, Aggregate>*>(this->mRight);
 }
 
 /*
@@ -123,29 +383,88 @@ End implementations for the AVLNode class.
 
 /**
 * A templated balanced binary search tree implemented as an AVL tree.
+*
+* The optional Aggregate policy (see SumAggregate and friends above) caches a summary of
+* every subtree in its root node, so aggregate(lo, hi) runs in O(log n). Summaries are
+* kept correct by insert, erase, the rotations and AVLNode::setValue. Assigning through
+* an iterator (it->second = v) bypasses them; use insert to update a value instead.
+*
+* With a policy that has range updates (such as RangeAddAggregate), updateRange(lo, hi,
+* tag) updates every value in [lo, hi] in O(log n) by leaving tags on subtree roots.
+* Tags are pushed down by every descent (insert, erase, find, aggregate) and before every
+* rotation, so point reads stay O(log n). Iteration needs every value to be exact, so
+* begin(), lowerBound() and findMany() first flush all pending tags, which costs O(n)
+* once after a batch of range updates. Those lookups are BinarySearchTree's own, which
+* reach the push-downs through the updatesPending, findAndPush and flushUpdates hooks,
+* so the values read do not depend on the static type of the tree.
 */
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+template <class Key, class Value, class Aggregate = NoAggregate<Value>, class Allocator = std::allocator<std::pair<Key, Value> > >
+class AVLTree : public BinarySearchTree<Key, Value, Allocator>
 {
 public:
+    typedef typename BinarySearchTree<Key, Value, Allocator>::iterator iterator;
+
+    explicit AVLTree(const Allocator& allocator = Allocator());
+    virtual ~AVLTree();
+
     // Methods for inserting/removing elements from the tree. You must implement
     // both of these methods.
     virtual void insert(const std::pair<Key, Value>& keyValuePair) override;
-    virtual void erase(const Key& key);
+    virtual void erase(const Key& key) override;
+    // erase(iterator), erase(first, last) and erase_if rebalance through removeNode.
+    using BinarySearchTree<Key, Value, Allocator>::erase;
+    // Lazy erase: with maxErasedFraction > 0, erase(key) only marks the node as a
+    // tombstone, in one descent with no successor swap and no rotations. Lookups,
+    // iteration and aggregates skip tombstones, and inserting the key again revives one.
+    // When tombstones make up more than maxErasedFraction of the nodes, they are all
+    // removed by one O(n) rebuild (purgeErased). 0, the default, purges them and erases
+    // eagerly again.
+    void setLazyErase(double maxErasedFraction);
+
+    // Combines, in key order, the values of every item with lo <= key <= hi.
+    typename Aggregate::type aggregate(const Key& lo, const Key& hi) const;
+    // Applies tag to the value of every item with lo <= key <= hi.
+    void updateRange(const Key& lo, const Key& hi, const typename Aggregate::tag& tag);
+
+    virtual void flushUpdates() const override;
 
 private:
     /* Helper functions are strongly encouraged to help separate the problem
        into smaller pieces. You should not need additional data members. */
 
     /* You should write these helpers for sure.  You may add others. */
-    void rotateLeft (AVLNode<Key, Value> *n);
-    void rotateRight (AVLNode<Key, Value> *n);
-    void insertFix(AVLNode<Key, Value> *parent, AVLNode<Key, Value>* child);
-    AVLNode<Key, Value>* getSuccessor(AVLNode<Key, Value>* node);
-    void removeFix(AVLNode<Key, Value> *n, int diff);
+    void rotateLeft (AVLNode<Key, Value, Aggregate> *n);
+    void rotateRight (AVLNode<Key, Value, Aggregate> *n);
+    void insertFix(AVLNode<Key, Value, Aggregate> *parent, AVLNode<Key, Value, Aggregate>* child);
+    AVLNode<Key, Value, Aggregate>* getSuccessor(AVLNode<Key, Value, Aggregate>* node);
+    void removeFix(AVLNode<Key, Value, Aggregate> *n, int diff);
+    typename Aggregate::type aggregateHelper(AVLNode<Key, Value, Aggregate>* n, const Key* lo, const Key* hi) const;
+    void updateRangeHelper(AVLNode<Key, Value, Aggregate>* n, const Key* lo, const Key* hi, const typename Aggregate::tag& tag);
+    void flushHelper(AVLNode<Key, Value, Aggregate>* n) const;
+
+protected:
+    virtual bool validateNode(Node<Key, Value>* node, int leftHeight, int rightHeight, std::string& error) const override;
+    virtual void destroyNode(Node<Key, Value>* node) override;
+    virtual Node<Key, Value>* createDetachedNode(const Key& key, const Value& value) override;
+    virtual void removeNode(Node<Key, Value>* node) override;
+    virtual bool updatesPending() const override;
+    virtual AVLNode<Key, Value, Aggregate>* findAndPush(const Key& key) const override;
+    virtual void rebuildNode(Node<Key, Value>* node, int leftHeight, int rightHeight) override;
+    virtual void compactNodes() override;
+    AVLNode<Key, Value, Aggregate>* createNode(const Key& key, const Value& value, AVLNode<Key, Value, Aggregate>* parent);
+
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<AVLNode<Key, Value, Aggregate> > NodeAllocator;
+    typedef std::allocator_traits<NodeAllocator> NodeTraits;
+
+private:
 
     /* A provided helper function to swap 2 nodes location in the tree */
-    void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    void nodeSwap( AVLNode<Key, Value, Aggregate>* n1, AVLNode<Key, Value, Aggregate>* n2);
+
+    // Set by updateRange, cleared once every tag has been flushed.
+    mutable bool mPendingUpdates;
+    // The tombstone fraction that triggers a purge; 0 when erasing eagerly.
+    double mMaxErasedFraction;
 };
 
 /*
@@ -155,48 +474,124 @@ Begin implementations for the AVLTree class.
 */
 
 /**
-* Insert function for a key value pair. Finds location to insert the node and then balances the tree.
+* Constructor.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+AVLTree<Key, Value, Aggregate, Allocator>::AVLTree(const Allocator& allocator)
+    : BinarySearchTree<Key, Value, Allocator>(allocator),
+      mPendingUpdates(false),
+      mMaxErasedFraction(0)
+{
+
+}
+
+/**
+* Destructor. Frees the nodes here, where destroyNode still resolves to the AVLNode
+* version.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+AVLTree<Key, Value, Aggregate, Allocator>::~AVLTree()
+{
+    this->clear();
+}
+
+/**
+* Allocates and constructs an AVLNode with the tree's allocator rebound to AVLNode.
 */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+AVLNode<Key, Value, Aggregate>* AVLTree<Key, Value, Aggregate, Allocator>::createNode(const Key& key, const Value& value, AVLNode<Key, Value, Aggregate>* parent)
 {
-    //create a new node
-    AVLNode<Key,Value>* new_node = new AVLNode<Key,Value>(keyValuePair.first, keyValuePair.second, NULL);
-    new_node->setBalance(0);   
-    new_node->setRight(NULL);
-    new_node->setLeft(NULL);
+    NodeAllocator allocator(this->mAllocator);
+    AVLNode<Key, Value, Aggregate>* node = NodeTraits::allocate(allocator, 1);
+    try {
+        NodeTraits::construct(allocator, node, key, value, parent);
+    }
+    catch (...) {
+        NodeTraits::deallocate(allocator, node, 1);
+        throw;
+    }
+    this->nodeCreated(node);
+    return node;
+}
 
+/**
+* Makes an unlinked AVLNode, for assignSorted.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+Node<Key, Value>* AVLTree<Key, Value, Aggregate, Allocator>::createDetachedNode(const Key& key, const Value& value)
+{
+    return createNode(key, value, NULL);
+}
+
+/**
+* Destroys an AVLNode and returns its memory to the allocator.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::destroyNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value, Aggregate>* avlNode = static_cast<AVLNode<Key, Value, Aggregate>*>(node);
+    this->nodeDestroyed(node);
+    this->freeNode(avlNode);
+}
+
+/**
+* Relocates AVLNodes, balance, summary and pending tag included.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::compactNodes()
+{
+    this->template relocateNodes<AVLNode<Key, Value, Aggregate> >();
+}
+
+/**
+* Insert function for a key value pair. Finds location to insert the node and then balances the tree.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::insert(const std::pair<Key, Value>& keyValuePair)
+{
     if (this->mRoot == NULL) {
-        this->mRoot = new_node;
+        this->mRoot = createNode(keyValuePair.first, keyValuePair.second, NULL);
         return;
     }
 
-    AVLNode<Key,Value> *parent = NULL;
-    AVLNode<Key,Value>* next = static_cast<AVLNode<Key,Value>*>(this->mRoot);
+    AVLNode<Key, Value, Aggregate> *parent = NULL;
+    AVLNode<Key, Value, Aggregate>* next = static_cast<AVLNode<Key, Value, Aggregate>*>(this->mRoot);
+    AVLNode<Key, Value, Aggregate>* new_node = NULL;
 
+    // the node is only allocated once its slot is found, so updating an existing key
+    // never touches the allocator
     while (true){
         parent = next;
+        parent->pushTag();
         if (keyValuePair.first  == parent->getKey()){
+            if (parent->isErased()) {
+                // revive the tombstone; setValue below refreshes the summaries
+                parent->setErased(false);
+                --this->mErasedNodes;
+                ++this->mSize;
+            }
             parent->setValue(keyValuePair.second);
             return;
         }
         else if (keyValuePair.first < parent->getKey()) {
             if (parent->getLeft() == NULL) {
+                new_node = createNode(keyValuePair.first, keyValuePair.second, parent);
                 parent->setLeft(new_node);
-                new_node->setParent(parent);
                 break;
             }
             next = parent->getLeft();
         } 
         else {
             if (parent->getRight() == NULL) {
+                new_node = createNode(keyValuePair.first, keyValuePair.second, parent);
                 parent->setRight(new_node);
-                new_node->setParent(parent);
                 break;
             }
             next = parent->getRight();
         }
     }
+    // bring the summaries along the new path up to date before any rotation
+    new_node->updateSummaries();
 
     if (parent->getBalance() == -1 || parent->getBalance() == 1) {
         parent->setBalance(0);
@@ -213,15 +608,15 @@ void AVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
     }
 
 }
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value> *parent, AVLNode<Key, Value>* child)
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::insertFix(AVLNode<Key, Value, Aggregate> *parent, AVLNode<Key, Value, Aggregate>* child)
  {
     // parent and grandparent should not be NULL
     if (parent == NULL || parent->getParent() == NULL) {
         return;
     }
 
-    AVLNode<Key, Value> *grandparent = parent->getParent();
+    AVLNode<Key, Value, Aggregate> *grandparent = parent->getParent();
 
     if (parent == grandparent->getLeft()) { // left child of grandparent
         grandparent->setBalance(grandparent->getBalance() - 1);
@@ -303,18 +698,20 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value> *parent, AVLNode<Key, Va
     }
 }
 
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLTree<Key, Value>::getSuccessor(AVLNode<Key, Value>* node) 
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+AVLNode<Key, Value, Aggregate>* AVLTree<Key, Value, Aggregate, Allocator>::getSuccessor(AVLNode<Key, Value, Aggregate>* node) 
 {
     if (node->getRight() != NULL) {
         node = node->getRight();
+        node->pushTag();
         while (node->getLeft() != NULL) {
             node = node->getLeft();
+            node->pushTag();
         }
         return node;
     }
     else{
-        AVLNode<Key, Value>* parent = node->getParent();
+        AVLNode<Key, Value, Aggregate>* parent = node->getParent();
         while(parent != NULL && node == parent->getRight()){
             node = parent;
             parent = parent->getParent();
@@ -324,33 +721,79 @@ AVLNode<Key, Value>* AVLTree<Key, Value>::getSuccessor(AVLNode<Key, Value>* node
 }
 
 /**
-* Remove function for a given key. Finds the node, reattaches pointers, and then balances when finished.
+* Remove function for a given key. Finds the node, then removes and rebalances, or in
+* lazy mode just marks it erased. The tombstone stays in the miss filter and the find
+* cache until it is purged; find() checks the flag.
 */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::erase(const Key& key)
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::erase(const Key& key)
 {
-    AVLNode<Key, Value>* node = static_cast<AVLNode<Key,Value>*>(this->internalFind(key));
+    AVLNode<Key, Value, Aggregate>* node = findAndPush(key);
 
-    if (node == NULL) {
+    if (node == NULL || node->isErased()) {
         return;  // the value is not in the BST
     }
+    if (mMaxErasedFraction <= 0) {
+        removeNode(node);
+        return;
+    }
+    node->setErased(true);
+    node->updateSummaries();
+    --this->mSize;
+    ++this->mErasedNodes;
+    if (this->mErasedNodes > mMaxErasedFraction * (this->mSize + this->mErasedNodes)) {
+        this->purgeErased();
+    }
+}
+
+/**
+* Switches between lazy and eager erase. Turning lazy erase off, or lowering the
+* fraction, takes effect at once.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::setLazyErase(double maxErasedFraction)
+{
+    mMaxErasedFraction = maxErasedFraction;
+    if (mMaxErasedFraction <= 0 || this->mErasedNodes > mMaxErasedFraction * (this->mSize + this->mErasedNodes)) {
+        this->purgeErased();
+    }
+}
+
+/**
+* Removes a node that is already known: reattaches pointers, and then balances when
+* finished. A node reached without a search (erase by iterator) may still have tags
+* pending above it, so its path from the root is pushed first.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::removeNode(Node<Key, Value>* target)
+{
+    AVLNode<Key, Value, Aggregate>* node = static_cast<AVLNode<Key, Value, Aggregate>*>(target);
+    if (Aggregate::lazy && mPendingUpdates) {
+        std::vector<AVLNode<Key, Value, Aggregate>*> path;
+        for (AVLNode<Key, Value, Aggregate>* n = node; n != NULL; n = n->getParent()) {
+            path.push_back(n);
+        }
+        for (size_t i = path.size(); i > 0; --i) {
+            path[i - 1]->pushTag();
+        }
+    }
 
     if (node->getLeft() != NULL && node->getRight() != NULL) {
-        AVLNode<Key, Value>* successor = getSuccessor(node);
+        AVLNode<Key, Value, Aggregate>* successor = getSuccessor(node);
         nodeSwap(node, successor);
     }
 
-    AVLNode<Key, Value> *child = node->getLeft();
+    AVLNode<Key, Value, Aggregate> *child = node->getLeft();
     if (node->getRight() != NULL) {
         child = node->getRight();
     }
 
-    AVLNode<Key, Value>* parent = node->getParent();
+    AVLNode<Key, Value, Aggregate>* parent = node->getParent();
     if (child != NULL){
         child->setParent(parent);
     }
 
-    int diff;
+    int diff = 0;
     if (parent == NULL) {
         this->mRoot = child;
     } 
@@ -366,131 +809,131 @@ void AVLTree<Key, Value>::erase(const Key& key)
     }
 
     // delete node
-    delete node;
+    destroyNode(node);
 
+    if (parent != NULL) {
+        parent->updateSummaries();
+    }
     removeFix(parent, diff);
 }
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* n, int diff)
+/**
+* Rebalances the tree after a removal. diff is the change in n's balance caused by the
+* removal (+1 when its left subtree shrank, -1 when its right subtree shrank).
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::removeFix(AVLNode<Key, Value, Aggregate>* n, int diff)
 {
     if (n == NULL){
         return;
     }
 
-    AVLNode<Key, Value>* p = n->getParent();
-    AVLNode<Key, Value>* c;
+    AVLNode<Key, Value, Aggregate>* p = n->getParent();
+    AVLNode<Key, Value, Aggregate>* c;
 
     int ndiff = -1;
     if (p != NULL && n==p->getLeft()){
         ndiff = 1;
     }
-    //negative
-    if (n->getBalance() + diff == -2){
-        //zig zig
-        c = n->getLeft();
-        if (c->getBalance() == -1 || c->getBalance() == 0){
-            rotateRight(n);
-            if(c->getBalance() == -1){
+
+    //left subtree is now taller
+    if (diff == -1){
+        if (n->getBalance() + diff == -2){
+            c = n->getLeft();
+            if (c->getBalance() == -1){ //zig zig
+                rotateRight(n);
                 n->setBalance(0);
                 c->setBalance(0);
                 removeFix(p,ndiff);
             }
-            if(c->getBalance() == 0){
+            else if (c->getBalance() == 0){ //zig zig, height unchanged
+                rotateRight(n);
                 n->setBalance(-1);
                 c->setBalance(1);
-                return;
             }
-        }
-        else{
-            AVLNode<Key, Value>* g = c->getRight();
-            rotateLeft(c);
-            rotateRight(n);
-            if (g->getBalance() == 1){
-                n->setBalance(0);
-                c->setBalance(-1);
-                g->setBalance(0);
-            }
-            if(g->getBalance() == 0){
-                n->setBalance(0);
-                c->setBalance(0);
-                g->setBalance(0);
-            }
-            if (g->getBalance() == 1){
-                n->setBalance(1);
-                c->setBalance(0);
+            else{ //zig zag
+                AVLNode<Key, Value, Aggregate>* g = c->getRight();
+                rotateLeft(c);
+                rotateRight(n);
+                if (g->getBalance() == 1){
+                    n->setBalance(0);
+                    c->setBalance(-1);
+                }
+                else if (g->getBalance() == 0){
+                    n->setBalance(0);
+                    c->setBalance(0);
+                }
+                else{
+                    n->setBalance(1);
+                    c->setBalance(0);
+                }
                 g->setBalance(0);
+                removeFix(p,ndiff);
             }
+        }
+        else if (n->getBalance() + diff == -1){
+            n->setBalance(-1);
+        }
+        else{
+            n->setBalance(0);
             removeFix(p,ndiff);
         }
-    }
-    else if (n->getBalance() == 0){
-        n->setBalance(n->getBalance() + diff);
         return;
     }
-    else{
-        n->setBalance(0);
-        removeFix(p,ndiff);
-    }
 
-    //negative
+    //right subtree is now taller
     if (n->getBalance() + diff == 2){
-        //zig zig
         c = n->getRight();
-        if (c->getBalance() == 1 || c->getBalance() == 0){
+        if (c->getBalance() == 1){ //zig zig
             rotateLeft(n);
-            if(c->getBalance() == 1){
-                n->setBalance(0);
-                c->setBalance(0);
-                removeFix(p,ndiff);
-            }
-            if(c->getBalance() == 0){
-                n->setBalance(1);
-                c->setBalance(-1);
-                return;
-            }
+            n->setBalance(0);
+            c->setBalance(0);
+            removeFix(p,ndiff);
+        }
+        else if (c->getBalance() == 0){ //zig zig, height unchanged
+            rotateLeft(n);
+            n->setBalance(1);
+            c->setBalance(-1);
         }
-        else{//zig zag
-            AVLNode<Key, Value>* g = c->getLeft();
+        else{ //zig zag
+            AVLNode<Key, Value, Aggregate>* g = c->getLeft();
             rotateRight(c);
-            rotateLeft(n);            
+            rotateLeft(n);
             if (g->getBalance() == -1){
                 n->setBalance(0);
                 c->setBalance(1);
-                g->setBalance(0);
             }
-            if(g->getBalance() == 0){
+            else if (g->getBalance() == 0){
                 n->setBalance(0);
                 c->setBalance(0);
-                g->setBalance(0);
             }
-            if (g->getBalance() == -1){
+            else{
                 n->setBalance(-1);
                 c->setBalance(0);
-                g->setBalance(0);
             }
+            g->setBalance(0);
             removeFix(p,ndiff);
         }
     }
-    else if (n->getBalance() == 0){
-        n->setBalance(n->getBalance() + diff);
-        return;
+    else if (n->getBalance() + diff == 1){
+        n->setBalance(1);
     }
     else{
         n->setBalance(0);
         removeFix(p,ndiff);
     }
-
-
 }
 
 /**
 * Rotates n down and to the left
 */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::rotateLeft (AVLNode<Key, Value> *n)
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::rotateLeft (AVLNode<Key, Value, Aggregate> *n)
 {
-    AVLNode<Key, Value>* y = n->getRight();
-    AVLNode<Key, Value>* rootParent = n->getParent();
+    AVLNode<Key, Value, Aggregate>* y = n->getRight();
+    AVLNode<Key, Value, Aggregate>* rootParent = n->getParent();
+    // y's subtree is about to be split between y and n
+    n->pushTag();
+    y->pushTag();
     y->setParent(rootParent);
 
     //set the root parent
@@ -505,7 +948,7 @@ void AVLTree<Key, Value>::rotateLeft (AVLNode<Key, Value> *n)
     }    
 
     //pointer shifts
-    AVLNode<Key, Value>* c = y->getLeft();
+    AVLNode<Key, Value, Aggregate>* c = y->getLeft();
 
     y->setLeft(n);
     n->setParent(y);
@@ -513,17 +956,22 @@ void AVLTree<Key, Value>::rotateLeft (AVLNode<Key, Value> *n)
     if (c != NULL){
         c->setParent(n);
     }
-    
+
+    // n is now y's child, so it is recomputed first
+    n->updateSummary();
+    y->updateSummary();
 }
 
 /**
 * Rotates n down and to the right
 */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::rotateRight (AVLNode<Key, Value> *n)
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::rotateRight (AVLNode<Key, Value, Aggregate> *n)
 {
-    AVLNode<Key, Value>* y = n->getLeft();
-    AVLNode<Key, Value>* rootParent = n->getParent();
+    AVLNode<Key, Value, Aggregate>* y = n->getLeft();
+    AVLNode<Key, Value, Aggregate>* rootParent = n->getParent();
+    n->pushTag();
+    y->pushTag();
 
     y->setParent(rootParent);
     if (n->getParent() == NULL) {        
@@ -536,7 +984,7 @@ void AVLTree<Key, Value>::rotateRight (AVLNode<Key, Value> *n)
         rootParent->setLeft(y);
     }    
 
-    AVLNode<Key, Value>* c = y->getRight();
+    AVLNode<Key, Value, Aggregate>* c = y->getRight();
 
     y->setRight(n);
     n->setParent(y);
@@ -544,14 +992,215 @@ void AVLTree<Key, Value>::rotateRight (AVLNode<Key, Value> *n)
     if (c != NULL){
         c->setParent(n);
     }
+
+    n->updateSummary();
+    y->updateSummary();
+}
+
+/**
+* Range aggregate over [lo, hi]. Returns Aggregate::identity() if the range is empty.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+typename Aggregate::type AVLTree<Key, Value, Aggregate, Allocator>::aggregate(const Key& lo, const Key& hi) const
+{
+    if (hi < lo) {
+        return Aggregate::identity();
+    }
+    return aggregateHelper(static_cast<AVLNode<Key, Value, Aggregate>*>(this->mRoot), &lo, &hi);
+}
+
+/**
+* Aggregates the items of n's subtree within [*lo, *hi]; a NULL bound is unbounded on
+* that side. Once the search splits at a node inside the range, each half has only one
+* bound left, and whole subtrees on the inner side are taken from their cached summary,
+* so only two root-to-leaf paths are walked.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+typename Aggregate::type AVLTree<Key, Value, Aggregate, Allocator>::aggregateHelper(AVLNode<Key, Value, Aggregate>* n, const Key* lo, const Key* hi) const
+{
+    if (n == NULL) {
+        return Aggregate::identity();
+    }
+    if (lo == NULL && hi == NULL) {
+        return n->getSummary();
+    }
+    n->pushTag();
+    if (lo != NULL && n->getKey() < *lo) {
+        return aggregateHelper(n->getRight(), lo, hi);
+    }
+    if (hi != NULL && *hi < n->getKey()) {
+        return aggregateHelper(n->getLeft(), lo, hi);
+    }
+    typename Aggregate::type left = aggregateHelper(n->getLeft(), lo, NULL);
+    typename Aggregate::type right = aggregateHelper(n->getRight(), NULL, hi);
+    if (n->isErased()) {
+        return Aggregate::combine(left, right);
+    }
+    return Aggregate::combine(Aggregate::combine(left, Aggregate::lift(n->getKey(), n->getValue())), right);
+}
+
+/**
+* Range update over [lo, hi]. O(log n) regardless of how many items are covered.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::updateRange(const Key& lo, const Key& hi, const typename Aggregate::tag& tag)
+{
+    if (hi < lo || !Aggregate::hasTag(tag)) {
+        return;
+    }
+    updateRangeHelper(static_cast<AVLNode<Key, Value, Aggregate>*>(this->mRoot), &lo, &hi, tag);
+    mPendingUpdates = true;
+}
+
+/**
+* Mirrors aggregateHelper: subtrees entirely inside the range just receive the tag, and
+* the nodes on the two boundary paths are updated one by one and have their summaries
+* recomputed on the way back up.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::updateRangeHelper(AVLNode<Key, Value, Aggregate>* n, const Key* lo, const Key* hi, const typename Aggregate::tag& tag)
+{
+    if (n == NULL) {
+        return;
+    }
+    if (lo == NULL && hi == NULL) {
+        n->applyTag(tag);
+        return;
+    }
+    n->pushTag();
+    if (lo != NULL && n->getKey() < *lo) {
+        updateRangeHelper(n->getRight(), lo, hi, tag);
+    }
+    else if (hi != NULL && *hi < n->getKey()) {
+        updateRangeHelper(n->getLeft(), lo, hi, tag);
+    }
+    else {
+        Aggregate::applyToValue(n->getValue(), tag);
+        updateRangeHelper(n->getLeft(), lo, NULL, tag);
+        updateRangeHelper(n->getRight(), NULL, hi, tag);
+    }
+    n->updateSummary();
+}
+
+/**
+* True while range updates wait in tags. find() then searches with findAndPush rather
+* than through the find cache, which would skip the pushes, and finger search starts
+* from the root, since a climb would miss the tags above the finger.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+bool AVLTree<Key, Value, Aggregate, Allocator>::updatesPending() const
+{
+    return Aggregate::lazy && mPendingUpdates;
+}
+
+/**
+* internalFind that pushes tags down along the search path, so the node found (and every
+* ancestor) holds its exact value. Iterating onwards from the result is only safe once
+* begin() or lowerBound() has flushed the tree.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+AVLNode<Key, Value, Aggregate>* AVLTree<Key, Value, Aggregate, Allocator>::findAndPush(const Key& key) const
+{
+    if (!Aggregate::lazy) {
+        return static_cast<AVLNode<Key, Value, Aggregate>*>(this->internalFind(key));
+    }
+    AVLNode<Key, Value, Aggregate>* n = static_cast<AVLNode<Key, Value, Aggregate>*>(this->mRoot);
+    while (n != NULL) {
+        n->pushTag();
+        if (key < n->getKey()) {
+            n = n->getLeft();
+        }
+        else if (n->getKey() < key) {
+            n = n->getRight();
+        }
+        else {
+            return n;
+        }
+    }
+    return NULL;
+}
+
+/**
+* Restores a node of a tree rebuilt by a bulk erase. Children are rebuilt first, so
+* their summaries are already current.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::rebuildNode(Node<Key, Value>* node, int leftHeight, int rightHeight)
+{
+    AVLNode<Key, Value, Aggregate>* avlNode = static_cast<AVLNode<Key, Value, Aggregate>*>(node);
+    avlNode->setBalance((char)(rightHeight - leftHeight));
+    avlNode->updateSummary();
+}
+
+/**
+* Pushes every pending tag down to the leaves. O(n), and only done once after a batch of
+* range updates.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::flushUpdates() const
+{
+    if (!Aggregate::lazy || !mPendingUpdates) {
+        return;
+    }
+    flushHelper(static_cast<AVLNode<Key, Value, Aggregate>*>(this->mRoot));
+    mPendingUpdates = false;
+}
+
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::flushHelper(AVLNode<Key, Value, Aggregate>* n) const
+{
+    if (n == NULL) {
+        return;
+    }
+    n->pushTag();
+    flushHelper(n->getLeft());
+    flushHelper(n->getRight());
+}
+
+/**
+* Checks the stored balance. With subtree heights (a full validate()) it must equal
+* rightHeight - leftHeight; in sampled mode it must be in [-1, 1] and agree with which
+* children exist, since a node with one child can only lean towards it.
+*/
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+bool AVLTree<Key, Value, Aggregate, Allocator>::validateNode(Node<Key, Value>* node, int leftHeight, int rightHeight, std::string& error) const
+{
+    int balance = static_cast<AVLNode<Key, Value, Aggregate>*>(node)->getBalance();
+    if (balance < -1 || balance > 1) {
+        error = "AVL balance out of range";
+        return false;
+    }
+    if (leftHeight >= 0) {
+        if (balance != rightHeight - leftHeight) {
+            error = "AVL balance does not match subtree heights";
+            return false;
+        }
+        return true;
+    }
+    int expected = balance;
+    if (node->getLeft() == NULL && node->getRight() == NULL) {
+        expected = 0;
+    }
+    else if (node->getLeft() == NULL) {
+        expected = 1;
+    }
+    else if (node->getRight() == NULL) {
+        expected = -1;
+    }
+    if (balance != expected) {
+        error = "AVL balance does not match the children present";
+        return false;
+    }
+    return true;
 }
 
 /**
  * Given a correct AVL tree, this functions relinks the tree in such a way that
  * the nodes swap positions in the tree.  Balances are also swapped.
+ * Keys stay with their nodes, so find cache entries remain valid.
  */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<typename Key, typename Value, typename Aggregate, typename Allocator>
+void AVLTree<Key, Value, Aggregate, Allocator>::nodeSwap( AVLNode<Key, Value, Aggregate>* n1, AVLNode<Key, Value, Aggregate>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -644,4 +1293,10 @@ End implementations for the AVLTree class.
 ------------------------------------------
 */
 
+/**
+* An AVLTree whose nodes come from a std::pmr::memory_resource.
+*/
+template <typename Key, typename Value, typename Aggregate = NoAggregate<Value> >
+using PmrAVLTree = AVLTree<Key, Value, Aggregate, std::pmr::polymorphic_allocator<std::pair<Key, Value> > >;
+
 #endif
\ No newline at end of file
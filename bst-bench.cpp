@@ -0,0 +1,759 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fcntl.h>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "avlbst.h"
+#include "buffered-tree.h"
+#include "cold-value-tree.h"
+#include "concurrent-avl.h"
+#include "durable-avl.h"
+#include "parallel-tree.h"
+#include "prefix-string.h"
+#include "scapegoat-tree.h"
+#include "sharded-tree.h"
+#include "small-map.h"
+#include "tree-export.h"
+
+using namespace std;
+
+// Returns the number of operations per second achieved by running ops operations.
+template <typename Fn>
+double opsPerSecond(size_t ops, Fn fn)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    fn();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return ops / elapsed.count();
+}
+
+// Applies the same insert/erase mix to tree.
+template <typename Tree>
+void mixedWorkload(Tree& tree, const vector<int>& keys)
+{
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 4 == 3) {
+            tree.erase(keys[i - 1]);
+        }
+        else {
+            tree.insert(make_pair(keys[i], (long)i));
+        }
+    }
+}
+
+void benchDurability(size_t n)
+{
+    mt19937 rng(104);
+    vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = (int)rng();
+    }
+
+    cout << "Durability (" << n << " mixed insert/erase ops)" << endl;
+    {
+        AVLTree<int, long> tree;
+        cout << "  in-memory AVLTree:\t" << opsPerSecond(n, [&] { mixedWorkload(tree, keys); })
+             << " ops/s" << endl;
+    }
+
+    const string path = "/tmp/bst-bench";
+    const size_t groups[] = {1, 64, 1024};
+    for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); ++g) {
+        ::unlink((path + ".wal").c_str());
+        ::unlink((path + ".ckpt").c_str());
+        WalOptions options;
+        options.groupCommitRecords = groups[g];
+        options.checkpointRecords = n / 2;
+        DurableAVLTree<int, long> tree(path, options);
+        double rate = opsPerSecond(n, [&] {
+            mixedWorkload(tree, keys);
+            tree.commit();
+        });
+        cout << "  durable, group commit " << groups[g] << ":\t" << rate << " ops/s" << endl;
+    }
+    ::unlink((path + ".wal").c_str());
+    ::unlink((path + ".ckpt").c_str());
+}
+
+void benchFindMany(size_t n)
+{
+    mt19937 rng(104);
+    AVLTree<int, long> tree;
+    vector<int> keys;
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back((int)rng());
+        tree.insert(make_pair(keys.back(), (long)i));
+    }
+    // half hits, half (probable) misses, in random order
+    vector<int> probes(n);
+    for (size_t i = 0; i < n; ++i) {
+        probes[i] = (i % 2) ? keys[rng() % n] : (int)rng();
+    }
+
+    cout << "Lookup (" << n << " keys)" << endl;
+    long found = 0;
+    double single = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            found += (tree.find(probes[i]) != tree.end());
+        }
+    });
+    cout << "  find:\t\t" << single << " ops/s" << endl;
+
+    const size_t batch = 64;
+    vector<int> batchKeys;
+    vector<AVLTree<int, long>::iterator> results;
+    double batched = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; i += batch) {
+            batchKeys.assign(probes.begin() + i, probes.begin() + min(n, i + batch));
+            tree.findMany(batchKeys, results);
+            for (size_t j = 0; j < results.size(); ++j) {
+                found -= (results[j] != tree.end());
+            }
+        }
+    });
+    cout << "  findMany(" << batch << "):\t" << batched << " ops/s" << endl;
+    if (found != 0) {
+        cout << "  error: find and findMany disagree" << endl;
+    }
+}
+
+// Lookups that each land a few keys after the previous one, from the root and by finger.
+void benchFingerSearch(size_t n)
+{
+    AVLTree<int, long> tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((int)i, (long)i));
+    }
+    mt19937 rng(104);
+    vector<int> probes(n);
+    int key = 0;
+    for (size_t i = 0; i < n; ++i) {
+        key = (key + 1 + rng() % 16) % (int)n;
+        probes[i] = key;
+    }
+
+    cout << "Lookup with locality (" << n << " keys, steps of 1-16)" << endl;
+    long rootSum = 0;
+    double rootRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            rootSum += tree.find(probes[i])->second;
+        }
+    });
+    cout << "  find:\t\t\t" << rootRate << " ops/s" << endl;
+    long fingerSum = 0;
+    double fingerRate = opsPerSecond(n, [&] {
+        AVLTree<int, long>::iterator finger = tree.end();
+        for (size_t i = 0; i < n; ++i) {
+            finger = tree.find(probes[i], finger);
+            fingerSum += finger->second;
+        }
+    });
+    cout << "  finger find:\t\t" << fingerRate << " ops/s" << endl;
+    if (rootSum != fingerSum) {
+        cout << "  error: find and finger find disagree" << endl;
+    }
+}
+
+// Lookups where 90% of the traffic goes to 1000 hot keys, with and without the find cache.
+void benchFindCache(size_t n)
+{
+    AVLTree<int, long> tree;
+    mt19937 rng(104);
+    vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = (int)rng();
+        tree.insert(make_pair(keys[i], (long)i));
+    }
+    vector<int> probes(n);
+    for (size_t i = 0; i < n; ++i) {
+        probes[i] = (rng() % 10 != 0) ? keys[rng() % 1000] : keys[rng() % n];
+    }
+
+    cout << "Lookup of hot keys (" << n << " keys, 90% on 1000 of them)" << endl;
+    long plainSum = 0;
+    double plainRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            plainSum += tree.find(probes[i])->second;
+        }
+    });
+    cout << "  find:\t\t\t" << plainRate << " ops/s" << endl;
+    tree.setFindCache(4096);
+    long cachedSum = 0;
+    double cachedRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            cachedSum += tree.find(probes[i])->second;
+        }
+    });
+    FindCacheStats stats = tree.findCacheStats();
+    cout << "  find with cache:\t" << cachedRate << " ops/s (hit rate " << stats.hitRate() << ")" << endl;
+    if (plainSum != cachedSum) {
+        cout << "  error: the cache returned a different item" << endl;
+    }
+
+    // a second pass with timing on, from an empty cache, for the latency split
+    tree.setFindCache(4096, true);
+    tree.resetFindCacheStats();
+    for (size_t i = 0; i < n; ++i) {
+        tree.find(probes[i]);
+    }
+    stats = tree.findCacheStats();
+    cout << "  hit / miss latency:\t" << stats.averageHitNanoseconds() << " / " << stats.averageMissNanoseconds() << " ns" << endl;
+}
+
+// Lookups of which half are for absent keys, with and without the miss filter.
+void benchMissFilter(size_t n)
+{
+    AVLTree<int, long> tree;
+    mt19937 rng(104);
+    vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = (int)(rng() | 1);
+        tree.insert(make_pair(keys[i], (long)i));
+    }
+    // even keys are never inserted
+    vector<int> probes(n);
+    for (size_t i = 0; i < n; ++i) {
+        probes[i] = (i % 2) ? keys[rng() % n] : (int)(rng() & ~1u);
+    }
+
+    cout << "Lookup, half misses (" << n << " keys)" << endl;
+    long plainFound = 0;
+    double plainRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            plainFound += (tree.find(probes[i]) != tree.end());
+        }
+    });
+    cout << "  find:\t\t\t" << plainRate << " ops/s" << endl;
+    tree.setMissFilter(true);
+    long filteredFound = 0;
+    double filteredRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            filteredFound += (tree.find(probes[i]) != tree.end());
+        }
+    });
+    cout << "  find with filter:\t" << filteredRate << " ops/s" << endl;
+    if (plainFound != filteredFound) {
+        cout << "  error: the filter rejected a present key" << endl;
+    }
+}
+
+// Sorted inserts then random lookups, on an AVL tree and on a scapegoat tree.
+template <typename Tree>
+void benchSortedTree(const char* label, size_t n, const vector<int>& probes)
+{
+    Tree tree;
+    double insertRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair((int)i, (long)i));
+        }
+    });
+    long sum = 0;
+    double findRate = opsPerSecond(probes.size(), [&] {
+        for (size_t i = 0; i < probes.size(); ++i) {
+            sum += tree.find(probes[i])->second;
+        }
+    });
+    cout << "  " << label << "insert " << insertRate << " ops/s, find " << findRate << " ops/s" << endl;
+}
+
+void benchScapegoat(size_t n)
+{
+    mt19937 rng(104);
+    vector<int> probes(n);
+    for (size_t i = 0; i < n; ++i) {
+        probes[i] = rng() % n;
+    }
+    cout << "Sorted inserts (" << n << " keys)" << endl;
+    benchSortedTree<AVLTree<int, long> >("AVLTree:\t", n, probes);
+    benchSortedTree<ScapegoatTree<int, long> >("ScapegoatTree:\t", n, probes);
+    cout << "  node size: " << sizeof(AVLNode<int, long>) << " vs " << sizeof(Node<int, long>) << " bytes" << endl;
+}
+
+// Builds the given number of 8-item maps, then looks up one key in each.
+template <typename Map>
+void benchTinyMapsOf(const char* label, size_t maps, const vector<int>& keys)
+{
+    vector<Map*> all(maps);
+    double buildRate = opsPerSecond(maps * 8, [&] {
+        for (size_t m = 0; m < maps; ++m) {
+            all[m] = new Map();
+            for (size_t i = 0; i < 8; ++i) {
+                all[m]->insert(make_pair(keys[m * 8 + i], (long)i));
+            }
+        }
+    });
+    long sum = 0;
+    double findRate = opsPerSecond(maps, [&] {
+        for (size_t m = 0; m < maps; ++m) {
+            sum += all[m]->find(keys[m * 8 + m % 8])->second;
+        }
+    });
+    cout << "  " << label << "insert " << buildRate << " ops/s, find " << findRate << " ops/s" << endl;
+    for (size_t m = 0; m < maps; ++m) {
+        delete all[m];
+    }
+}
+
+void benchTinyMaps(size_t maps)
+{
+    mt19937 rng(104);
+    vector<int> keys(maps * 8);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = (int)rng();
+    }
+    cout << "Tiny maps (" << maps << " maps of 8 items)" << endl;
+    benchTinyMapsOf<AVLTree<int, long> >("AVLTree:\t", maps, keys);
+    benchTinyMapsOf<SmallMap<int, long> >("SmallMap:\t", maps, keys);
+}
+
+// Random lookups and a full in-order scan of tree.
+template <typename Tree>
+void benchLocality(const char* label, Tree& tree, const vector<int>& probes)
+{
+    long sum = 0;
+    double findRate = opsPerSecond(probes.size(), [&] {
+        for (size_t i = 0; i < probes.size(); ++i) {
+            typename Tree::iterator it = tree.find(probes[i]);
+            if (it != tree.end()) {
+                sum += it->second;
+            }
+        }
+    });
+    double scanRate = opsPerSecond(tree.size() * 5, [&] {
+        for (int pass = 0; pass < 5; ++pass) {
+            for (typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+                sum += it->second;
+            }
+        }
+    });
+    cout << "  " << label << "find " << findRate << " ops/s, scan " << scanRate << " items/s" << endl;
+}
+
+void benchCompact(size_t n)
+{
+    mt19937 rng(105);
+    AVLTree<int, long> tree;
+    vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = (int)rng();
+        tree.insert(make_pair(keys[i], (long)i));
+    }
+    // Replacing random keys for a while leaves neighbouring nodes far apart in memory.
+    for (size_t i = 0; i < n * 4; ++i) {
+        size_t victim = rng() % n;
+        tree.erase(keys[victim]);
+        keys[victim] = (int)rng();
+        tree.insert(make_pair(keys[victim], (long)i));
+    }
+    vector<int> probes(n);
+    for (size_t i = 0; i < n; ++i) {
+        probes[i] = keys[rng() % n];
+    }
+    cout << "Compaction (" << n << " keys after churn)" << endl;
+    benchLocality("scattered:\t", tree, probes);
+    double compactRate = opsPerSecond(tree.size(), [&] {
+        tree.compact();
+    });
+    cout << "  compact " << compactRate << " nodes/s" << endl;
+    benchLocality("compacted:\t", tree, probes);
+}
+
+// Erases half of n keys in random order, then looks up every key once.
+void benchEraseBurst(const char* label, size_t n, double maxErasedFraction, const vector<int>& order)
+{
+    AVLTree<int, long> tree;
+    tree.setLazyErase(maxErasedFraction);
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((int)i, (long)i));
+    }
+    double eraseRate = opsPerSecond(n / 2, [&] {
+        for (size_t i = 0; i < n / 2; ++i) {
+            tree.erase(order[i]);
+        }
+    });
+    long sum = 0;
+    double findRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            AVLTree<int, long>::iterator it = tree.find(order[i]);
+            if (it != tree.end()) {
+                sum += it->second;
+            }
+        }
+    });
+    cout << "  " << label << "erase " << eraseRate << " ops/s, find " << findRate << " ops/s" << endl;
+}
+
+void benchLazyErase(size_t n)
+{
+    mt19937 rng(106);
+    vector<int> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = (int)i;
+    }
+    shuffle(order.begin(), order.end(), rng);
+    cout << "Erase burst (" << n / 2 << " of " << n << " keys)" << endl;
+    benchEraseBurst("eager:\t\t", n, 0, order);
+    benchEraseBurst("lazy, 25%:\t", n, 0.25, order);
+    benchEraseBurst("lazy, 60%:\t", n, 0.6, order);
+}
+
+// Inserts keys one by one, then looks each one up.
+template <typename Insert, typename Find>
+void benchWrites(const char* label, const vector<int>& keys, Insert insert, Find find)
+{
+    double insertRate = opsPerSecond(keys.size(), [&] {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            insert(keys[i], (long)i);
+        }
+    });
+    long sum = 0;
+    double findRate = opsPerSecond(keys.size(), [&] {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sum += find(keys[i]);
+        }
+    });
+    cout << "  " << label << "insert " << insertRate << " ops/s, find " << findRate << " ops/s" << endl;
+}
+
+void benchBuffered(size_t n)
+{
+    mt19937 rng(107);
+    vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = (int)rng();
+    }
+    cout << "Random writes (" << n << " keys)" << endl;
+    {
+        AVLTree<int, long> tree;
+        benchWrites("AVLTree:\t", keys,
+            [&](int key, long value) { tree.insert(make_pair(key, value)); },
+            [&](int key) { return tree.find(key)->second; });
+    }
+    for (size_t capacity = 4096; capacity <= 262144; capacity *= 4) {
+        BufferedTree<int, long> tree(capacity);
+        string label = "buffer " + to_string(capacity) + ":\t";
+        benchWrites(label.c_str(), keys,
+            [&](int key, long value) { tree.insert(make_pair(key, value)); },
+            [&](int key) { long value = 0; tree.find(key, value); return value; });
+    }
+}
+
+// Runs fn(threadIndex) on threads threads and returns the total operations per second.
+template <typename Fn>
+double threadedOpsPerSecond(size_t threads, size_t opsPerThread, Fn fn)
+{
+    return opsPerSecond(threads * opsPerThread, [&] {
+        vector<thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.push_back(thread(fn, t));
+        }
+        for (size_t t = 0; t < threads; ++t) {
+            workers[t].join();
+        }
+    });
+}
+
+void benchSharded(size_t n)
+{
+    const int keySpace = 1 << 24;
+    const size_t shards = 64;
+    const size_t opsPerThread = n;
+
+    AVLTree<int, long> global;
+    mutex globalLock;
+    vector<int> bounds;
+    for (size_t i = 1; i < shards; ++i) {
+        bounds.push_back((int)(keySpace / shards * i));
+    }
+    ShardedTree<int, long> sharded(bounds);
+    ConcurrentAVLTree<int, long> concurrent;
+    mt19937 rng(104);
+    for (size_t i = 0; i < n; ++i) {
+        int key = (int)(rng() % keySpace);
+        global.insert(make_pair(key, (long)i));
+        sharded.insert(make_pair(key, (long)i));
+        concurrent.insert(make_pair(key, (long)i));
+    }
+
+    cout << "Concurrent mixed workload (80% find, 20% insert/erase)" << endl;
+    for (size_t threads = 1; threads <= thread::hardware_concurrency() && threads <= 16; threads *= 2) {
+        double locked = threadedOpsPerSecond(threads, opsPerThread, [&](size_t t) {
+            mt19937 local((unsigned)t);
+            for (size_t i = 0; i < opsPerThread; ++i) {
+                int key = (int)(local() % keySpace);
+                lock_guard<mutex> guard(globalLock);
+                if (i % 10 == 0) {
+                    global.insert(make_pair(key, (long)i));
+                }
+                else if (i % 10 == 1) {
+                    global.erase(key);
+                }
+                else {
+                    global.find(key);
+                }
+            }
+        });
+        double shardedRate = threadedOpsPerSecond(threads, opsPerThread, [&](size_t t) {
+            mt19937 local((unsigned)t);
+            long value;
+            for (size_t i = 0; i < opsPerThread; ++i) {
+                int key = (int)(local() % keySpace);
+                if (i % 10 == 0) {
+                    sharded.insert(make_pair(key, (long)i));
+                }
+                else if (i % 10 == 1) {
+                    sharded.erase(key);
+                }
+                else {
+                    sharded.find(key, value);
+                }
+            }
+        });
+        double concurrentRate = threadedOpsPerSecond(threads, opsPerThread, [&](size_t t) {
+            mt19937 local((unsigned)t);
+            long value;
+            for (size_t i = 0; i < opsPerThread; ++i) {
+                int key = (int)(local() % keySpace);
+                if (i % 10 == 0) {
+                    concurrent.insert(make_pair(key, (long)i));
+                }
+                else if (i % 10 == 1) {
+                    concurrent.erase(key);
+                }
+                else {
+                    concurrent.find(key, value);
+                }
+            }
+        });
+        cout << "  " << threads << " threads: global mutex " << locked << " ops/s, " << shards << " shards "
+             << shardedRate << " ops/s, fine-grained " << concurrentRate << " ops/s" << endl;
+    }
+}
+
+void benchParallel(size_t n)
+{
+    AVLTree<int, long> tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((int)i, (long)i));
+    }
+
+    cout << "Read-only pass (" << n << " items, " << WorkStealingPool::shared().size() << " workers)" << endl;
+    long sequential = 0;
+    double iterRate = opsPerSecond(n, [&] {
+        for (AVLTree<int, long>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sequential += it->second;
+        }
+    });
+    cout << "  iterator:\t\t" << iterRate << " items/s" << endl;
+
+    long parallel = 0;
+    double reduceRate = opsPerSecond(n, [&] {
+        parallel = parallelReduce(
+                tree,
+                0L,
+                [](long acc, const pair<int, long>& item) { return acc + item.second; },
+                [](long a, long b) { return a + b; });
+    });
+    cout << "  parallelReduce:\t" << reduceRate << " items/s" << endl;
+    if (parallel != sequential) {
+        cout << "  error: parallelReduce disagrees with the iterator" << endl;
+    }
+}
+
+void benchAggregate(size_t n)
+{
+    AVLTree<int, long, SumAggregate<long> > tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((int)i, (long)i));
+    }
+    mt19937 rng(104);
+    const size_t queries = 1000;
+    vector<int> starts(queries);
+    for (size_t i = 0; i < queries; ++i) {
+        starts[i] = rng() % n;
+    }
+    int width = (int)(n / 10);
+
+    cout << "Range sums (" << queries << " ranges of " << width << " keys)" << endl;
+    long scanned = 0;
+    double scanRate = opsPerSecond(queries, [&] {
+        for (size_t i = 0; i < queries; ++i) {
+            AVLTree<int, long, SumAggregate<long> >::iterator it = tree.lowerBound(starts[i]);
+            for (; it != tree.end() && it->first <= starts[i] + width; ++it) {
+                scanned += it->second;
+            }
+        }
+    });
+    cout << "  iterator scan:\t" << scanRate << " ranges/s" << endl;
+
+    long aggregated = 0;
+    double aggregateRate = opsPerSecond(queries, [&] {
+        for (size_t i = 0; i < queries; ++i) {
+            aggregated += tree.aggregate(starts[i], starts[i] + width);
+        }
+    });
+    cout << "  aggregate:\t\t" << aggregateRate << " ranges/s" << endl;
+    if (aggregated != scanned) {
+        cout << "  error: aggregate disagrees with the iterator" << endl;
+    }
+
+    AVLTree<int, long, RangeAddAggregate<long> > lazy;
+    for (size_t i = 0; i < n; ++i) {
+        lazy.insert(make_pair((int)i, (long)i));
+    }
+    cout << "Range adds (" << queries << " ranges of " << width << " keys)" << endl;
+    double iterAddRate = opsPerSecond(queries, [&] {
+        for (size_t i = 0; i < queries; ++i) {
+            AVLTree<int, long, RangeAddAggregate<long> >::iterator it = lazy.lowerBound(starts[i]);
+            for (; it != lazy.end() && it->first <= starts[i] + width; ++it) {
+                it->second += 1;
+            }
+        }
+    });
+    cout << "  iterator:\t\t" << iterAddRate << " ranges/s" << endl;
+    double lazyAddRate = opsPerSecond(queries, [&] {
+        for (size_t i = 0; i < queries; ++i) {
+            lazy.updateRange(starts[i], starts[i] + width, 1L);
+        }
+    });
+    cout << "  updateRange:\t\t" << lazyAddRate << " ranges/s" << endl;
+}
+
+void benchExport(size_t n)
+{
+    AVLTree<int, long> tree;
+    for (size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair((int)i, (long)i));
+    }
+    int fd = open("/dev/null", O_WRONLY);
+    cout << "Export to /dev/null (" << n << " items)" << endl;
+    double dotRate = opsPerSecond(n, [&] { exportDot(tree, fd); });
+    cout << "  DOT:\t\t\t" << dotRate << " nodes/s" << endl;
+    double jsonRate = opsPerSecond(n, [&] { exportJson(tree, fd); });
+    cout << "  JSON:\t\t\t" << jsonRate << " nodes/s" << endl;
+    close(fd);
+}
+
+void benchColdValues(size_t n)
+{
+    typedef array<char, 256> FatValue;
+    mt19937 rng(104);
+    vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = (int)rng();
+    }
+    AVLTree<int, FatValue> inlineTree;
+    ColdValueTree<int, FatValue> coldTree;
+    FatValue value;
+    for (size_t i = 0; i < n; ++i) {
+        value.fill((char)i);
+        inlineTree.insert(make_pair(keys[i], value));
+        coldTree.insert(make_pair(keys[i], value));
+    }
+    vector<int> probes(n);
+    for (size_t i = 0; i < n; ++i) {
+        probes[i] = keys[rng() % n];
+    }
+
+    cout << "Lookup with " << sizeof(FatValue) << "-byte values (" << n << " keys)" << endl;
+    long inlineSum = 0;
+    double inlineRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            inlineSum += inlineTree.find(probes[i])->second[0];
+        }
+    });
+    cout << "  values in nodes:	" << inlineRate << " ops/s" << endl;
+    long coldSum = 0;
+    double coldRate = opsPerSecond(n, [&] {
+        for (size_t i = 0; i < n; ++i) {
+            coldSum += (*coldTree.findValue(probes[i]))[0];
+        }
+    });
+    cout << "  value store:\t\t" << coldRate << " ops/s" << endl;
+    if (inlineSum != coldSum) {
+        cout << "  error: the two trees disagree" << endl;
+    }
+}
+
+// Random lowercase word of 4 to 11 letters.
+string randomWord(mt19937& rng)
+{
+    string word(4 + rng() % 8, 'a');
+    for (size_t i = 0; i < word.size(); ++i) {
+        word[i] = 'a' + rng() % 26;
+    }
+    return word;
+}
+
+// Inserts every key into a fresh tree, then looks every key up in shuffled order.
+template <typename Key>
+void benchStringTree(const char* label, const vector<string>& keys, const vector<string>& probes)
+{
+    vector<Key> treeKeys(keys.begin(), keys.end());
+    vector<Key> probeKeys(probes.begin(), probes.end());
+    AVLTree<Key, long> tree;
+    double insertRate = opsPerSecond(keys.size(), [&] {
+        for (size_t i = 0; i < treeKeys.size(); ++i) {
+            tree.insert(make_pair(treeKeys[i], (long)i));
+        }
+    });
+    long found = 0;
+    double findRate = opsPerSecond(probes.size(), [&] {
+        for (size_t i = 0; i < probeKeys.size(); ++i) {
+            found += (tree.find(probeKeys[i]) != tree.end());
+        }
+    });
+    cout << "  " << label << "insert " << insertRate << " ops/s, find " << findRate << " ops/s" << endl;
+    if (found != (long)probes.size()) {
+        cout << "  error: a key was not found" << endl;
+    }
+}
+
+void benchStringKeys(size_t n)
+{
+    mt19937 rng(104);
+    vector<string> urls, paths;
+    for (size_t i = 0; i < n; ++i) {
+        urls.push_back("https://" + randomWord(rng) + ".com/" + randomWord(rng) + "/" + to_string(rng() % 100000) + ".html");
+        paths.push_back("/home/" + randomWord(rng) + "/src/" + randomWord(rng) + "/" + randomWord(rng) + ".cpp");
+    }
+    vector<string> urlProbes(urls), pathProbes(paths);
+    shuffle(urlProbes.begin(), urlProbes.end(), rng);
+    shuffle(pathProbes.begin(), pathProbes.end(), rng);
+
+    cout << "URL keys (" << n << ")" << endl;
+    benchStringTree<string>("std::string:\t", urls, urlProbes);
+    benchStringTree<PrefixString>("PrefixString:\t", urls, urlProbes);
+    cout << "Path keys (" << n << ")" << endl;
+    benchStringTree<string>("std::string:\t", paths, pathProbes);
+    benchStringTree<PrefixString>("PrefixString:\t", paths, pathProbes);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+    benchDurability(n);
+    benchFindMany(n * 10);
+    benchFingerSearch(n * 10);
+    benchFindCache(n * 5);
+    benchMissFilter(n * 5);
+    benchScapegoat(n * 5);
+    benchCompact(n * 5);
+    benchLazyErase(n * 5);
+    benchBuffered(n * 5);
+    benchTinyMaps(n);
+    benchSharded(n);
+    benchParallel(n * 10);
+    benchAggregate(n * 10);
+    benchExport(n * 10);
+    benchColdValues(n * 5);
+    benchStringKeys(n * 5);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <map>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
 
@@ -41,6 +42,22 @@ int main(int argc, char *argv[])
     else {
         cout << "Did not find b" << endl;
     }
+    vector<char> keys;
+    keys.push_back('b');
+    keys.push_back('z');
+    keys.push_back('a');
+    vector<AVLTree<char,int>::iterator> results;
+    at.findMany(keys, results);
+    cout << "findMany b z a:";
+    for(size_t i = 0; i < results.size(); ++i) {
+        if(results[i] == at.end()) {
+            cout << " (none)";
+        }
+        else {
+            cout << " " << results[i]->second;
+        }
+    }
+    cout << endl;
     cout << "Erasing b" << endl;
     at.remove('b');
 
@@ -1,10 +1,21 @@
 #ifndef BST_H
 #define BST_H
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <cstdlib>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
+#include "counting-filter.h"
 
 /**
 * A templated class for a Node in a search tree. This represents a node in a normal
@@ -40,7 +51,10 @@ public:
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
-    void setValue(const Value &value);
+    virtual void setValue(const Value &value);
+    // True for a node that a lazy erase has left in place (a tombstone). Iterators and
+    // lookups skip such nodes. Plain nodes are never erased this way.
+    virtual bool isErased() const;
 
 protected:
     std::pair<Key, Value> mItem;
@@ -49,6 +63,18 @@ protected:
     Node<Key, Value>* mRight;
 };
 
+/**
+* Hints to the CPU that the node at ptr will be read soon.
+*/
+inline void prefetchNode(const void* ptr)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(ptr, 0, 3);
+#else
+    (void)ptr;
+#endif
+}
+
 /*
 -----------------------------------------
 Begin implementations for the Node class.
@@ -196,22 +222,75 @@ void Node<Key, Value>::setValue(const Value& value)
     mItem.second = value;
 }
 
+/**
+* A plain node is always live.
+*/
+template<typename Key, typename Value>
+bool Node<Key, Value>::isErased() const
+{
+    return false;
+}
+
 /*
 ---------------------------------------
 End implementations for the Node class.
 ---------------------------------------
 */
 
+/**
+* True when std::hash<T> is usable, which the find cache needs.
+*/
+template <typename T, typename = void>
+struct IsHashable : std::false_type {};
+template <typename T>
+struct IsHashable<T, decltype((void)std::hash<T>()(std::declval<const T&>()))> : std::true_type {};
+
+/**
+* Counters for the hot-key cache in front of find(). The times are only collected when
+* the cache was enabled with timing on.
+*/
+struct FindCacheStats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t hitNanoseconds;
+    uint64_t missNanoseconds;
+
+    double hitRate() const { return (hits + misses == 0) ? 0.0 : (double)hits / (hits + misses); }
+    double averageHitNanoseconds() const { return (hits == 0) ? 0.0 : (double)hitNanoseconds / hits; }
+    double averageMissNanoseconds() const { return (misses == 0) ? 0.0 : (double)missNanoseconds / misses; }
+};
+
 /**
 * A templated unbalanced binary search tree.
+*
+* Nodes are allocated through Allocator, rebound to the node type, so they can live in
+* a std::pmr arena (see PmrBinarySearchTree at the end of this file) or in any other custom
+* memory. Derived trees that allocate a larger node type override destroyNode and
+* compactNodes.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Allocator = std::allocator<std::pair<Key, Value> > >
 class BinarySearchTree
 {
 public:
+    typedef Allocator allocator_type;
+
     // Constructor/destructor.
-    BinarySearchTree();
-    ~BinarySearchTree();
+    explicit BinarySearchTree(const Allocator& allocator = Allocator());
+    virtual ~BinarySearchTree();
+
+    allocator_type get_allocator() const;
+
+    // Puts a hash cache of about slots hot keys in front of find(), so a repeated lookup
+    // reads one cache line and the node instead of a whole search path; 0 removes it.
+    // Keys without std::hash are never cached. find() then writes to the cache, so a tree
+    // with the cache on must not be searched by several threads at once.
+    void setFindCache(size_t slots, bool timed = false);
+    FindCacheStats findCacheStats() const;
+    void resetFindCacheStats();
+    // Keeps a counting Bloom filter of the keys, so find() answers most lookups of absent
+    // keys without searching. It grows with the tree. Keys without std::hash are ignored.
+    void setMissFilter(bool enabled);
 
     // A virtual insert function lets future derivations of this class implement
     // their specific insert logic.
@@ -223,6 +302,15 @@ public:
     // Prints the contents of the tree in a nice format. Useful for debugging.
     void print() const;
 
+    // Checks every invariant (key order, parent/child links and, in derived trees, their
+    // own per-node invariants such as AVL balance) in one O(n) pass. Returns false on
+    // the first violation, describing it in *error. *nodeCount receives the number of
+    // nodes reached.
+    bool validate(std::string* error = NULL, size_t* nodeCount = NULL) const;
+    // Spot-checks the same invariants along paths random root-to-leaf paths, in
+    // O(paths * height). Cheap enough to run continuously.
+    bool validateSampled(size_t paths, std::string* error = NULL) const;
+
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
@@ -249,24 +337,154 @@ public:
         virtual Node<Key, Value>* getSuccessor(Node<Key, Value>* node);       
 
         /* Feel free to add additional data members and/or helper functions! */
+        friend class BinarySearchTree<Key, Value, Allocator>;
     };
 
 public:
     // Access to data through iterators, just like you are used to with std::map, std::set,
-    // std::vector, etc.
-    iterator begin();
-    iterator end();
+    // std::vector, etc. begin(), lowerBound() and findMany() call flushUpdates() first,
+    // and find() makes the value it returns exact, so the values read are current for
+    // derived trees that defer updates too.
+    iterator begin() const;
+    iterator end() const;
     iterator find(const Key& key) const;
+    // Finger search: find(key), but starting from finger (usually the result of the
+    // previous lookup) instead of the root. Cheap when key is near finger in key order.
+    iterator find(const Key& key, iterator finger) const;
+    // Returns an iterator to the first item whose key is not less than key.
+    iterator lowerBound(const Key& key) const;
+    // Looks up every key in keys, storing find(keys[i]) in out[i].
+    void findMany(const std::vector<Key>& keys, std::vector<iterator>& out) const;
+
+    // Removes key, if present. A plain BST is not rebalanced afterwards.
+    virtual void erase(const Key& key);
+    // Same as erase(key).
+    void remove(const Key& key);
+    // Removes the item at pos without searching for it. Returns the item after it.
+    iterator erase(iterator pos);
+    // Removes every item in [first, last). Returns last.
+    iterator erase(iterator first, iterator last);
+    // Removes every item for which pred(item) is true. Returns how many were removed.
+    template <typename Pred>
+    size_t erase_if(Pred pred);
+
+    size_t size() const;
+    bool empty() const;
+
+    // Reshapes the tree into a balanced one (every level full except perhaps the last)
+    // in O(n) time without allocating, by rotations only (Day-Stout-Warren). Nodes are
+    // relinked, not copied, so iterators stay valid.
+    void rebalance();
+    // Replaces the contents with the items of [first, last), which must be sorted by
+    // strictly increasing key, building a balanced tree directly in O(n).
+    template <typename InputIt>
+    void assignSorted(InputIt first, InputIt last);
+    // Removes the tombstones a lazy erase (see AVLTree::setLazyErase) has left, in one
+    // O(n) rebuild. Live nodes keep their identity, so iterators stay valid.
+    void purgeErased();
+    // Moves every node into one contiguous allocation, laid out in van Emde Boas order so
+    // that the top levels of every search path share a few cache lines. Long insert and
+    // erase churn scatters nodes across the heap; this undoes it in O(n log log n). The
+    // shape and contents are unchanged (apart from purging tombstones), but nodes are
+    // copied, so iterators are invalidated.
+    void compact();
+    // Makes every stored value exact before a pass that reads them all, for code that
+    // walks the nodes directly rather than through begin(). A plain BST defers nothing;
+    // AVLTree flushes pending range updates.
+    virtual void flushUpdates() const;
 
 protected:
     Node<Key, Value>* internalFind(const Key& key) const;
+    Node<Key, Value>* internalFindFrom(const Key& key, Node<Key, Value>* finger) const;
+    // internalFind through the find cache, when there is one.
+    Node<Key, Value>* cachedFind(const Key& key) const;
+    // True while a derived tree holds updates that have not reached the stored values.
+    // find() then uses findAndPush, and finger search starts from the root.
+    virtual bool updatesPending() const;
+    // internalFind that also makes every value on the search path exact. A plain BST
+    // defers nothing, so this is internalFind.
+    virtual Node<Key, Value>* findAndPush(const Key& key) const;
+    // Bookkeeping for every node made by a createNode or freed by a destroyNode: the
+    // size, the find cache and the miss filter.
+    void nodeCreated(Node<Key, Value>* node);
+    void nodeDestroyed(Node<Key, Value>* node);
+    // True when the miss filter proves key is not in the tree.
+    bool missFilterRejects(const Key& key) const;
+    void rebuildMissFilter(size_t capacity);
+    static uint64_t missFilterHash(const Key& key);
     void printRoot (Node<Key, Value>* root) const;
     void deleteAll (Node<Key, Value>* root);
+    Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    // Destroys and frees a node. Overridden by trees whose nodes are a derived type.
+    virtual void destroyNode(Node<Key, Value>* node);
+    // createNode(key, value, NULL) for the tree's own node type.
+    virtual Node<Key, Value>* createDetachedNode(const Key& key, const Value& value);
+    // Unlinks node from the tree and frees it. Derived trees override this to rebalance.
+    virtual void removeNode(Node<Key, Value>* node);
+    // Called bottom-up on every node of a rebuilt tree, with its subtree heights, so
+    // derived trees can restore their per-node data.
+    virtual void rebuildNode(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    void replaceChild(Node<Key, Value>* parent, Node<Key, Value>* child, Node<Key, Value>* replacement);
+    Node<Key, Value>* buildBalanced(std::vector<Node<Key, Value>*>& nodes, size_t lo, size_t hi, Node<Key, Value>* parent, int& height);
+    void rebuildWithout(std::vector<Node<Key, Value>*>& survivors, std::vector<Node<Key, Value>*>& victims);
+    size_t treeToVine();
+    void compressVine(size_t rotations);
+    void restoreNodes(Node<Key, Value>* node, int& height);
+    // Copies the nodes into the compact block as the tree's own node type. AVLTree
+    // overrides this to relocate AVLNodes.
+    virtual void compactNodes();
+    template <typename NodeType>
+    void relocateNodes();
+    // Destroys a node and frees its memory, which may be a slot of the compact block.
+    template <typename NodeType>
+    void freeNode(NodeType* node);
+    static int levelCount(Node<Key, Value>* root);
+    static void nodesAtDepth(Node<Key, Value>* root, int depth, std::vector<Node<Key, Value>*>& out);
+    // Appends the nodes in the top levels levels below root, in van Emde Boas order.
+    static void vanEmdeBoasOrder(Node<Key, Value>* root, int levels, std::vector<Node<Key, Value>*>& out);
+    // Removing at least 1/BULK_ERASE_DIVISOR of the tree rebuilds it in O(n) instead of
+    // removing the items one by one in O(k log n).
+    static const size_t BULK_ERASE_DIVISOR = 8;
+    // The find cache is set associative: each 64-byte bucket holds FIND_CACHE_WAYS entries.
+    static const size_t FIND_CACHE_WAYS = 4;
+    struct FindCacheEntry
+    {
+        size_t hash;
+        Node<Key, Value>* node;
+    };
+    struct alignas(64) FindCacheBucket
+    {
+        FindCacheEntry entries[FIND_CACHE_WAYS];
+    };
+    // Hook for derived trees to check a node's own invariants. leftHeight and rightHeight
+    // are the heights of its subtrees, or -1 when they are unknown (sampled mode).
+    virtual bool validateNode(Node<Key, Value>* node, int leftHeight, int rightHeight, std::string& error) const;
+    bool validateLinks(Node<Key, Value>* node, const Key* lo, const Key* hi, std::string& error) const;
     /* Feel free to add additional member and/or helper functions! */
 
 public:
     // Main data member of the class.
     Node<Key, Value>* mRoot;
+
+protected:
+    // Node memory comes from here, rebound to the node type.
+    Allocator mAllocator;
+    // Number of items, counted where nodes are created and destroyed. Tombstones are
+    // counted in mErasedNodes instead.
+    size_t mSize;
+    // Empty when the find cache is off; otherwise a power-of-two number of buckets.
+    mutable std::vector<FindCacheBucket> mFindCache;
+    bool mFindCacheTimed;
+    mutable FindCacheStats mFindCacheStats;
+    bool mMissFilterOn;
+    CountingBloomFilter mMissFilter;
+    // The allocation the last compact() moved the nodes into (NULL if none), its size in
+    // nodes, and how many of them are still in the tree. It is freed with the last one.
+    void* mNodeBlock;
+    size_t mNodeBlockSize;
+    size_t mNodeBlockLive;
+    // Tombstones still linked into the tree. Always 0 unless a derived tree erases lazily.
+    size_t mErasedNodes;
 };
 
 /*
@@ -279,8 +497,8 @@ Begin implementations for the BinarySearchTree::iterator class.
 * Initialize the internal members of the iterator.
 * You can choose what kind of iterator the default constructor should create.
 */
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::iterator::iterator()
+template<typename Key, typename Value, typename Allocator>
+BinarySearchTree<Key, Value, Allocator>::iterator::iterator()
 {
     // TODO
     mCurrent = NULL;
@@ -289,8 +507,8 @@ BinarySearchTree<Key, Value>::iterator::iterator()
 /**
 * Initialize the internal members of the iterator.
 */
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr)
+template<typename Key, typename Value, typename Allocator>
+BinarySearchTree<Key, Value, Allocator>::iterator::iterator(Node<Key,Value>* ptr)
 {
     // TODO
     mCurrent = ptr;
@@ -299,8 +517,8 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr)
 /**
 * Provides access to the item.
 */
-template<typename Key, typename Value>
-std::pair<Key, Value>& BinarySearchTree<Key, Value>::iterator::operator*()
+template<typename Key, typename Value, typename Allocator>
+std::pair<Key, Value>& BinarySearchTree<Key, Value, Allocator>::iterator::operator*()
 {
     return mCurrent->getItem();
 }
@@ -308,8 +526,8 @@ std::pair<Key, Value>& BinarySearchTree<Key, Value>::iterator::operator*()
 /**
 * Provides access to the address of the item.
 */
-template<typename Key, typename Value>
-std::pair<Key, Value>* BinarySearchTree<Key, Value>::iterator::operator->()
+template<typename Key, typename Value, typename Allocator>
+std::pair<Key, Value>* BinarySearchTree<Key, Value, Allocator>::iterator::operator->()
 {
     return &(mCurrent->getItem());
 }
@@ -318,8 +536,8 @@ std::pair<Key, Value>* BinarySearchTree<Key, Value>::iterator::operator->()
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::iterator::operator==(const BinarySearchTree<Key, Value>::iterator& rhs) const
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::iterator::operator==(const BinarySearchTree<Key, Value, Allocator>::iterator& rhs) const
 {
     // TODO
     return (mCurrent == rhs.mCurrent);
@@ -329,8 +547,8 @@ bool BinarySearchTree<Key, Value>::iterator::operator==(const BinarySearchTree<K
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::iterator::operator!=(const BinarySearchTree<Key, Value>::iterator& rhs) const
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::iterator::operator!=(const BinarySearchTree<Key, Value, Allocator>::iterator& rhs) const
 {
     // TODO
     return (mCurrent != rhs.mCurrent);
@@ -339,8 +557,8 @@ bool BinarySearchTree<Key, Value>::iterator::operator!=(const BinarySearchTree<K
 /**
 * Sets one iterator equal to another iterator.
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator=(const BinarySearchTree<Key, Value>::iterator& rhs)
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator& BinarySearchTree<Key, Value, Allocator>::iterator::operator=(const BinarySearchTree<Key, Value, Allocator>::iterator& rhs)
 {
     // TODO
     this->mCurrent = rhs.mCurrent;
@@ -350,15 +568,17 @@ typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::i
 /**
 * Advances the iterator's location using an in-order traversal.
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator++()
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator& BinarySearchTree<Key, Value, Allocator>::iterator::operator++()
 {
-    mCurrent = getSuccessor(mCurrent);
+    do {
+        mCurrent = getSuccessor(mCurrent);
+    } while (mCurrent != NULL && mCurrent->isErased());
     return *this;
 }
 
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::iterator::getSuccessor(Node<Key, Value>* node)
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::iterator::getSuccessor(Node<Key, Value>* node)
 {
     if (node->getRight() != NULL) {
         node = node->getRight();
@@ -394,21 +614,43 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::BinarySearchTree()
-    : mRoot(NULL)
+template<typename Key, typename Value, typename Allocator>
+BinarySearchTree<Key, Value, Allocator>::BinarySearchTree(const Allocator& allocator)
+    : mRoot(NULL),
+      mAllocator(allocator),
+      mSize(0),
+      mFindCacheTimed(false),
+      mFindCacheStats(),
+      mMissFilterOn(false),
+      mNodeBlock(NULL),
+      mNodeBlockSize(0),
+      mNodeBlockLive(0),
+      mErasedNodes(0)
 {
 
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Destructor. A derived tree with its own destroyNode must clear() in its own destructor,
+* since the override can no longer be reached from here.
+*/
+template<typename Key, typename Value, typename Allocator>
+BinarySearchTree<Key, Value, Allocator>::~BinarySearchTree()
 {
     deleteAll(mRoot);
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+* Returns a copy of the allocator.
+*/
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::allocator_type BinarySearchTree<Key, Value, Allocator>::get_allocator() const
+{
+    return mAllocator;
+}
+
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::print() const
 {
     printRoot(mRoot);
     std::cout << "\n";
@@ -417,24 +659,31 @@ void BinarySearchTree<Key, Value>::print() const
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::begin()
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator BinarySearchTree<Key, Value, Allocator>::begin() const
 {
     // TODO
+    flushUpdates();
     Node<Key, Value>* temp = mRoot;
+    if (temp == NULL){
+        return end();
+    }
     while (temp->getLeft() != NULL){
         temp = temp->getLeft();
     }
 
     iterator it(temp);
+    if (temp->isErased()) {
+        ++it;
+    }
     return it;
 }
 
 /**
 * Returns an iterator whose value means INVALID
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::end()
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator BinarySearchTree<Key, Value, Allocator>::end() const
 {
     // TODO
     iterator it(NULL);
@@ -445,61 +694,175 @@ typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::en
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
 */
-template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::find(const Key& key) const
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator BinarySearchTree<Key, Value, Allocator>::find(const Key& key) const
 {
-	Node<Key, Value>* temp = internalFind(key);
+	if (missFilterRejects(key)) {
+		return end();
+	}
+	Node<Key, Value>* temp = updatesPending() ? findAndPush(key) : cachedFind(key);
+	if (temp != NULL && temp->isErased()) {
+		return end();
+	}
 	iterator it(temp);
 	return it;
 }
 
+/**
+* Finger search. Returns the end iterator if key does not exist, so keep the old finger
+* after a miss. A finger of end() searches from the root, as does any finger while
+* updates are pending.
+*/
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator BinarySearchTree<Key, Value, Allocator>::find(const Key& key, iterator finger) const
+{
+	if (updatesPending()) {
+		return find(key);
+	}
+	Node<Key, Value>* node = internalFindFrom(key, finger.mCurrent);
+	if (node != NULL && node->isErased()) {
+		return end();
+	}
+	return iterator(node);
+}
+
+/**
+* Returns an iterator to the smallest item with a key greater than or equal to key,
+* or the end iterator if every key is smaller
+*/
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator BinarySearchTree<Key, Value, Allocator>::lowerBound(const Key& key) const
+{
+    flushUpdates();
+    Node<Key, Value>* curr = mRoot;
+    Node<Key, Value>* best = NULL;
+    while (curr != NULL) {
+        if (curr->getKey() < key) {
+            curr = curr->getRight();
+        }
+        else {
+            best = curr;
+            curr = curr->getLeft();
+        }
+    }
+    iterator it(best);
+    if (best != NULL && best->isErased()) {
+        ++it;
+    }
+    return it;
+}
+
+/**
+* Batched lookup. Instead of finishing one descent before starting the next, up to
+* FIND_MANY_LANES descents advance one level at a time in round robin, and each step
+* prefetches the child it moves to. By the time a lane comes around again its node has
+* usually arrived in cache, so the cache misses of the different lookups overlap instead
+* of being paid one after another. A lane that finishes picks up the next pending key.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::findMany(const std::vector<Key>& keys, std::vector<iterator>& out) const
+{
+    const size_t FIND_MANY_LANES = 16;
+    flushUpdates();
+    out.assign(keys.size(), iterator(NULL));
+    if (mRoot == NULL) {
+        return;
+    }
+
+    Node<Key, Value>* curr[FIND_MANY_LANES];
+    size_t index[FIND_MANY_LANES];
+    size_t lanes = 0;
+    size_t next = 0;
+    while (lanes < FIND_MANY_LANES && next < keys.size()) {
+        curr[lanes] = mRoot;
+        index[lanes++] = next++;
+    }
+
+    while (lanes > 0) {
+        for (size_t i = 0; i < lanes; ) {
+            Node<Key, Value>* node = curr[i];
+            const Key& key = keys[index[i]];
+            if (node->getKey() == key) {
+                if (!node->isErased()) {
+                    out[index[i]] = iterator(node);
+                }
+                node = NULL;
+            }
+            else if (key < node->getKey()) {
+                node = node->getLeft();
+            }
+            else {
+                node = node->getRight();
+            }
+
+            if (node == NULL) {
+                // this lookup is done; start the next key or retire the lane
+                if (next < keys.size()) {
+                    curr[i] = mRoot;
+                    index[i] = next++;
+                }
+                else {
+                    --lanes;
+                    curr[i] = curr[lanes];
+                    index[i] = index[lanes];
+                    continue;
+                }
+            }
+            else {
+                prefetchNode(node);
+                curr[i] = node;
+            }
+            ++i;
+        }
+    }
+}
+
 /**
 * An insert method to insert into a Binary Search Tree. The tree will not remain balanced when
 * inserting.  Implementing this will help you test your iterator, but is not necessary: if you
 * don't implement it, then you can put your entire insert implementation in avlbst.h
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::insert(const std::pair<Key, Value>& keyValuePair)
 {
 
     //if the root is null, insert the value there
     if(mRoot == NULL){
-        Node<Key, Value>* newRoot = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-        mRoot = newRoot;
+        mRoot = createNode(keyValuePair.first, keyValuePair.second, NULL);
         return;
     }
 
-    Node<Key, Value>* curr = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
     Node<Key, Value>* curr_parent = mRoot;
 
-
-    while(curr != NULL){
+    while(true){
         //if the value being inserted is less than the root, traverse to the left
-        if(curr->getKey() < curr_parent->getKey()){
+        if(keyValuePair.first < curr_parent->getKey()){
             if(curr_parent->getLeft() != NULL){
                 curr_parent = curr_parent->getLeft();
             }
             else{
-                Node<Key, Value>* newRoot = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, curr_parent);
-                newRoot->setValue(keyValuePair.second);
-                curr_parent->setLeft(newRoot);
+                curr_parent->setLeft(createNode(keyValuePair.first, keyValuePair.second, curr_parent));
                 return;
             }
         }
 
         //if the value being inserted is greater than the root, traverse to the right
-        else if(curr->getKey() > curr_parent->getKey()){
+        else if(curr_parent->getKey() < keyValuePair.first){
             if(curr_parent->getRight() != NULL){
                curr_parent = curr_parent->getRight();
             }
             else{
-                Node<Key, Value>* newRoot = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, curr_parent);
-                newRoot->setValue(keyValuePair.second);
-                curr_parent->setRight(newRoot);
+                curr_parent->setRight(createNode(keyValuePair.first, keyValuePair.second, curr_parent));
                 return;
             }
         }
-    }    
+
+        //the key is already present, so just update its value
+        else{
+            curr_parent->setValue(keyValuePair.second);
+            return;
+        }
+    }
 
 }
 
@@ -507,8 +870,8 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<Key, Value>& keyValueP
 * A method to remove all contents of the tree and reset the values in the tree
 * for use again.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::clear()
 {
     deleteAll(mRoot);
     mRoot = NULL;
@@ -519,8 +882,8 @@ void BinarySearchTree<Key, Value>::clear()
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::internalFind(const Key& key) const
 {
     Node<Key, Value>* curr = mRoot;
     while (curr)
@@ -541,11 +904,1043 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
     return NULL;
 }
 
+/**
+* Enables, resizes or (with 0 slots) removes the find cache. Resizing empties it.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::setFindCache(size_t slots, bool timed)
+{
+    std::vector<FindCacheBucket>().swap(mFindCache);
+    mFindCacheTimed = timed;
+    if (slots == 0 || !IsHashable<Key>::value) {
+        return;
+    }
+    size_t buckets = 1;
+    while (buckets * FIND_CACHE_WAYS < slots) {
+        buckets *= 2;
+    }
+    mFindCache.resize(buckets, FindCacheBucket());
+}
+
+/**
+* Returns the hit and miss counters collected since the last reset.
+*/
+template<typename Key, typename Value, typename Allocator>
+FindCacheStats BinarySearchTree<Key, Value, Allocator>::findCacheStats() const
+{
+    return mFindCacheStats;
+}
+
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::resetFindCacheStats()
+{
+    mFindCacheStats = FindCacheStats();
+}
+
+/**
+* Looks key up in its bucket first. An entry matches on the full hash and is confirmed
+* against the node's key; a miss searches the tree and caches the result in a free way,
+* or else in the way picked by the hash's upper bits.
+*/
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::cachedFind(const Key& key) const
+{
+    if constexpr (IsHashable<Key>::value) {
+        if (!mFindCache.empty()) {
+            std::chrono::steady_clock::time_point start;
+            if (mFindCacheTimed) {
+                start = std::chrono::steady_clock::now();
+            }
+            size_t hash = std::hash<Key>()(key);
+            FindCacheBucket& bucket = mFindCache[hash & (mFindCache.size() - 1)];
+            Node<Key, Value>* found = NULL;
+            for (size_t i = 0; i < FIND_CACHE_WAYS; ++i) {
+                FindCacheEntry& entry = bucket.entries[i];
+                if (entry.node != NULL && entry.hash == hash && entry.node->getKey() == key) {
+                    found = entry.node;
+                    break;
+                }
+            }
+            bool hit = (found != NULL);
+            if (!hit) {
+                found = internalFind(key);
+                if (found != NULL) {
+                    size_t way = (hash / mFindCache.size()) % FIND_CACHE_WAYS;
+                    for (size_t i = 0; i < FIND_CACHE_WAYS; ++i) {
+                        if (bucket.entries[i].node == NULL) {
+                            way = i;
+                            break;
+                        }
+                    }
+                    bucket.entries[way].hash = hash;
+                    bucket.entries[way].node = found;
+                }
+            }
+            uint64_t nanoseconds = 0;
+            if (mFindCacheTimed) {
+                nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+            if (hit) {
+                ++mFindCacheStats.hits;
+                mFindCacheStats.hitNanoseconds += nanoseconds;
+            }
+            else {
+                ++mFindCacheStats.misses;
+                mFindCacheStats.missNanoseconds += nanoseconds;
+            }
+            return found;
+        }
+    }
+    return internalFind(key);
+}
+
+/**
+* Counts a new node and adds its key to the miss filter, doubling the filter first if
+* the tree has outgrown it. The node is not linked yet, so a rebuild adds it separately.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::nodeCreated(Node<Key, Value>* node)
+{
+    ++mSize;
+    if constexpr (IsHashable<Key>::value) {
+        if (!mMissFilterOn) {
+            return;
+        }
+        if (mSize > mMissFilter.capacity()) {
+            rebuildMissFilter(2 * mSize);
+            if (!mMissFilterOn) {
+                return;
+            }
+        }
+        mMissFilter.add(missFilterHash(node->getKey()));
+    }
+}
+
+/**
+* Uncounts a node that is about to be freed. Nodes keep their key for life and are never
+* moved (restructuring relinks them), so a find cache entry only goes stale here.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::nodeDestroyed(Node<Key, Value>* node)
+{
+    if (node->isErased()) {
+        --mErasedNodes;
+    }
+    else {
+        --mSize;
+    }
+    if constexpr (IsHashable<Key>::value) {
+        if (mMissFilterOn) {
+            mMissFilter.remove(missFilterHash(node->getKey()));
+        }
+        if (mFindCache.empty()) {
+            return;
+        }
+        size_t hash = std::hash<Key>()(node->getKey());
+        FindCacheBucket& bucket = mFindCache[hash & (mFindCache.size() - 1)];
+        for (size_t i = 0; i < FIND_CACHE_WAYS; ++i) {
+            if (bucket.entries[i].node == node) {
+                bucket.entries[i].node = NULL;
+            }
+        }
+    }
+}
+
+/**
+* Turns the miss filter on (built from the current keys) or off.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::setMissFilter(bool enabled)
+{
+    mMissFilterOn = false;
+    CountingBloomFilter().swap(mMissFilter);
+    if (enabled && IsHashable<Key>::value) {
+        rebuildMissFilter(std::max((size_t)1024, 2 * mSize));
+    }
+}
+
+/**
+* Replaces the filter with one of the given capacity holding every key in the tree.
+* The filter is only an optimization, so if memory runs out it is switched off.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::rebuildMissFilter(size_t capacity)
+{
+    if constexpr (IsHashable<Key>::value) {
+        try {
+            CountingBloomFilter filter(capacity);
+            std::vector<Node<Key, Value>*> stack;
+            if (mRoot != NULL) {
+                stack.push_back(mRoot);
+            }
+            while (!stack.empty()) {
+                Node<Key, Value>* node = stack.back();
+                stack.pop_back();
+                filter.add(missFilterHash(node->getKey()));
+                if (node->getLeft() != NULL) {
+                    stack.push_back(node->getLeft());
+                }
+                if (node->getRight() != NULL) {
+                    stack.push_back(node->getRight());
+                }
+            }
+            filter.swap(mMissFilter);
+            mMissFilterOn = true;
+        }
+        catch (const std::bad_alloc&) {
+            mMissFilterOn = false;
+            CountingBloomFilter().swap(mMissFilter);
+        }
+    }
+}
+
+/**
+* Checks the miss filter. Always false when it is off.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::missFilterRejects(const Key& key) const
+{
+    if constexpr (IsHashable<Key>::value) {
+        return mMissFilterOn && !mMissFilter.mayContain(missFilterHash(key));
+    }
+    return false;
+}
+
+/**
+* std::hash is often the identity for integers, so its result is mixed (the splitmix64
+* finalizer) before the filter takes block and probe bits from it.
+*/
+template<typename Key, typename Value, typename Allocator>
+uint64_t BinarySearchTree<Key, Value, Allocator>::missFilterHash(const Key& key)
+{
+    uint64_t hash = 0;
+    if constexpr (IsHashable<Key>::value) {
+        hash = std::hash<Key>()(key);
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+/**
+* Climbs from finger only until an ancestor bounds key on the side it lies, which
+* proves key is inside the current subtree, then descends from there. For keys d
+* positions away from the finger the climb usually stops O(log d) levels up; keys on
+* either side of a high ancestor can still cost a climb to that ancestor.
+*/
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::internalFindFrom(const Key& key, Node<Key, Value>* finger) const
+{
+    if (finger == NULL) {
+        return internalFind(key);
+    }
+    Node<Key, Value>* curr = finger;
+    bool goLeft = key < curr->getKey();
+    while (curr->getParent() != NULL && !(curr->getKey() == key))
+    {
+        Node<Key, Value>* parent = curr->getParent();
+        bool fromRight = (curr == parent->getRight());
+        // coming up from the right, the parent is the subtree's lower bound; from the
+        // left, its upper bound. Stop at the first bound on key's side that key passes.
+        if (goLeft && fromRight && parent->getKey() < key)
+        {
+            break;
+        }
+        if (!goLeft && !fromRight && key < parent->getKey())
+        {
+            break;
+        }
+        curr = parent;
+    }
+    while (curr)
+    {
+        if (curr->getKey() == key)
+        {
+            return curr;
+        }
+        else if (key < curr->getKey())
+        {
+            curr = curr->getLeft();
+        }
+        else
+        {
+            curr = curr->getRight();
+        }
+    }
+    return NULL;
+}
+
+/**
+* Full check. An explicit stack replaces recursion so degenerate trees cannot overflow
+* the call stack; each frame carries the exclusive key bounds inherited from its
+* ancestors and the heights of its finished subtrees. Links are checked before a child
+* is entered, so a corrupted child pointer cannot send the walk around a cycle.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::validate(std::string* error, size_t* nodeCount) const
+{
+    struct Frame
+    {
+        Node<Key, Value>* node;
+        const Key* lo;
+        const Key* hi;
+        int stage; // 0 = new, 1 = left subtree done, 2 = both subtrees done
+        int leftHeight;
+        int rightHeight;
+    };
+
+    std::string problem;
+    size_t count = 0;
+    std::vector<Frame> stack;
+    if (mRoot != NULL && mRoot->getParent() != NULL) {
+        problem = "root has a parent";
+    }
+    else if (mRoot != NULL) {
+        Frame root = { mRoot, NULL, NULL, 0, 0, 0 };
+        stack.push_back(root);
+    }
+
+    while (problem.empty() && !stack.empty()) {
+        Frame& frame = stack.back();
+        Node<Key, Value>* node = frame.node;
+        if (frame.stage == 0) {
+            ++count;
+            if (!validateLinks(node, frame.lo, frame.hi, problem)) {
+                break;
+            }
+            frame.stage = 1;
+            if (node->getLeft() != NULL) {
+                Frame left = { node->getLeft(), frame.lo, &node->getKey(), 0, 0, 0 };
+                stack.push_back(left);
+            }
+        }
+        else if (frame.stage == 1) {
+            frame.stage = 2;
+            if (node->getRight() != NULL) {
+                Frame right = { node->getRight(), &node->getKey(), frame.hi, 0, 0, 0 };
+                stack.push_back(right);
+            }
+        }
+        else {
+            if (!validateNode(node, frame.leftHeight, frame.rightHeight, problem)) {
+                break;
+            }
+            int height = 1 + std::max(frame.leftHeight, frame.rightHeight);
+            stack.pop_back();
+            if (!stack.empty()) {
+                // the parent is waiting on whichever side it pushed last
+                if (stack.back().stage == 1) {
+                    stack.back().leftHeight = height;
+                }
+                else {
+                    stack.back().rightHeight = height;
+                }
+            }
+        }
+    }
+
+    if (problem.empty() && count != mSize + mErasedNodes) {
+        problem = "node count does not match size()";
+    }
+    if (nodeCount != NULL) {
+        *nodeCount = count;
+    }
+    if (error != NULL) {
+        *error = problem;
+    }
+    return problem.empty();
+}
+
+/**
+* Sampled check. Each path starts at the root and takes a random existing child at
+* every step, checking the same local invariants as validate() on the way. Subtree
+* heights are not known, so derived trees only check what a node's neighbours show.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::validateSampled(size_t paths, std::string* error) const
+{
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    std::string problem;
+    if (mRoot != NULL && mRoot->getParent() != NULL) {
+        problem = "root has a parent";
+    }
+    for (size_t i = 0; problem.empty() && mRoot != NULL && i < paths; ++i) {
+        Node<Key, Value>* node = mRoot;
+        const Key* lo = NULL;
+        const Key* hi = NULL;
+        while (node != NULL) {
+            if (!validateLinks(node, lo, hi, problem) || !validateNode(node, -1, -1, problem)) {
+                break;
+            }
+            Node<Key, Value>* left = node->getLeft();
+            Node<Key, Value>* right = node->getRight();
+            if (left != NULL && (right == NULL || (rng() & 1) == 0)) {
+                hi = &node->getKey();
+                node = left;
+            }
+            else {
+                lo = &node->getKey();
+                node = right;
+            }
+        }
+    }
+    if (error != NULL) {
+        *error = problem;
+    }
+    return problem.empty();
+}
+
+/**
+* Checks that node's key lies strictly between the bounds and that its children point
+* back to it.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::validateLinks(Node<Key, Value>* node, const Key* lo, const Key* hi, std::string& error) const
+{
+    if ((lo != NULL && !(*lo < node->getKey())) || (hi != NULL && !(node->getKey() < *hi))) {
+        error = "key out of order";
+        return false;
+    }
+    if (node->getLeft() != NULL && node->getLeft() == node->getRight()) {
+        error = "left and right child are the same node";
+        return false;
+    }
+    if ((node->getLeft() != NULL && node->getLeft()->getParent() != node)
+            || (node->getRight() != NULL && node->getRight()->getParent() != node)) {
+        error = "child's parent link does not point back";
+        return false;
+    }
+    return true;
+}
+
+/**
+* A plain BST has no per-node invariants beyond its links.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::validateNode(Node<Key, Value>*, int, int, std::string&) const
+{
+    return true;
+}
+
+/**
+* Removes key from the tree, if it is there.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::erase(const Key& key)
+{
+    Node<Key, Value>* node = internalFind(key);
+    if (node != NULL) {
+        removeNode(node);
+    }
+}
+
+/**
+* The name the original tests use for erase.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::remove(const Key& key)
+{
+    erase(key);
+}
+
+/**
+* Erase by position. Nodes keep their identity when the tree is relinked or rotated, so
+* the successor found beforehand is still the next item afterwards.
+*/
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator BinarySearchTree<Key, Value, Allocator>::erase(iterator pos)
+{
+    if (pos.mCurrent == NULL) {
+        return pos;
+    }
+    iterator next(pos.mCurrent);
+    ++next;
+    removeNode(pos.mCurrent);
+    return next;
+}
+
+/**
+* Range erase. The range is walked once to count it; a large range is removed by
+* rebuilding the survivors into a balanced tree, a small one node by node. Tombstones
+* are purged first, since the survivors are collected by iterating, which skips them.
+*/
+template<typename Key, typename Value, typename Allocator>
+typename BinarySearchTree<Key, Value, Allocator>::iterator BinarySearchTree<Key, Value, Allocator>::erase(iterator first, iterator last)
+{
+    purgeErased();
+    std::vector<Node<Key, Value>*> victims;
+    for (iterator it = first; it != last; ++it) {
+        victims.push_back(it.mCurrent);
+    }
+    if (victims.size() * BULK_ERASE_DIVISOR < mSize) {
+        for (size_t i = 0; i < victims.size(); ++i) {
+            removeNode(victims[i]);
+        }
+        return last;
+    }
+
+    std::vector<Node<Key, Value>*> survivors;
+    survivors.reserve(mSize - victims.size());
+    bool inRange = false;
+    for (iterator it = begin(); it != end(); ++it) {
+        if (it == first) {
+            inRange = true;
+        }
+        if (it == last) {
+            inRange = false;
+        }
+        if (!inRange) {
+            survivors.push_back(it.mCurrent);
+        }
+    }
+    rebuildWithout(survivors, victims);
+    return last;
+}
+
+/**
+* Conditional erase. Every item has to be tested anyway, so this is one O(n) pass plus
+* either a rebuild or k individual removals, whichever is cheaper. Tombstones are purged
+* first, as for a range erase.
+*/
+template<typename Key, typename Value, typename Allocator>
+template<typename Pred>
+size_t BinarySearchTree<Key, Value, Allocator>::erase_if(Pred pred)
+{
+    purgeErased();
+    flushUpdates();
+    std::vector<Node<Key, Value>*> survivors;
+    std::vector<Node<Key, Value>*> victims;
+    for (iterator it = begin(); it != end(); ++it) {
+        if (pred(*it)) {
+            victims.push_back(it.mCurrent);
+        }
+        else {
+            survivors.push_back(it.mCurrent);
+        }
+    }
+    if (victims.size() * BULK_ERASE_DIVISOR < mSize) {
+        for (size_t i = 0; i < victims.size(); ++i) {
+            removeNode(victims[i]);
+        }
+    }
+    else {
+        rebuildWithout(survivors, victims);
+    }
+    return victims.size();
+}
+
+/**
+* Returns the number of items.
+*/
+template<typename Key, typename Value, typename Allocator>
+size_t BinarySearchTree<Key, Value, Allocator>::size() const
+{
+    return mSize;
+}
+
+/**
+* Returns true if the tree holds no items.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::empty() const
+{
+    return mSize == 0;
+}
+
+/**
+* Unbalanced removal. A node with two children is replaced by its successor, which is
+* relinked rather than copied so iterators to other items stay valid.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::removeNode(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    if (node->getLeft() != NULL && node->getRight() != NULL) {
+        Node<Key, Value>* successor = node->getRight();
+        while (successor->getLeft() != NULL) {
+            successor = successor->getLeft();
+        }
+        if (successor != node->getRight()) {
+            // detach the successor, then give it node's right subtree
+            replaceChild(successor->getParent(), successor, successor->getRight());
+            if (successor->getRight() != NULL) {
+                successor->getRight()->setParent(successor->getParent());
+            }
+            successor->setRight(node->getRight());
+            node->getRight()->setParent(successor);
+        }
+        successor->setLeft(node->getLeft());
+        node->getLeft()->setParent(successor);
+        replaceChild(parent, node, successor);
+        successor->setParent(parent);
+    }
+    else {
+        Node<Key, Value>* child = (node->getLeft() != NULL) ? node->getLeft() : node->getRight();
+        replaceChild(parent, node, child);
+        if (child != NULL) {
+            child->setParent(parent);
+        }
+    }
+    destroyNode(node);
+}
+
+/**
+* A plain BST has nothing pending.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool BinarySearchTree<Key, Value, Allocator>::updatesPending() const
+{
+    return false;
+}
+
+/**
+* With nothing pending, a plain descent.
+*/
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::findAndPush(const Key& key) const
+{
+    return internalFind(key);
+}
+
+/**
+* A plain BST has nothing to flush.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::flushUpdates() const
+{
+
+}
+
+/**
+* A plain BST keeps no per-node data.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::rebuildNode(Node<Key, Value>*, int, int)
+{
+
+}
+
+/**
+* Points parent's link to child at replacement instead (or the root, if parent is NULL).
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::replaceChild(Node<Key, Value>* parent, Node<Key, Value>* child, Node<Key, Value>* replacement)
+{
+    if (parent == NULL) {
+        mRoot = replacement;
+    }
+    else if (parent->getLeft() == child) {
+        parent->setLeft(replacement);
+    }
+    else {
+        parent->setRight(replacement);
+    }
+}
+
+/**
+* Links nodes[lo, hi) (in key order) into a perfectly balanced subtree under parent and
+* returns its root. Recursion depth is O(log n).
+*/
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::buildBalanced(std::vector<Node<Key, Value>*>& nodes, size_t lo, size_t hi, Node<Key, Value>* parent, int& height)
+{
+    if (lo >= hi) {
+        height = 0;
+        return NULL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* node = nodes[mid];
+    int leftHeight, rightHeight;
+    node->setParent(parent);
+    node->setLeft(buildBalanced(nodes, lo, mid, node, leftHeight));
+    node->setRight(buildBalanced(nodes, mid + 1, hi, node, rightHeight));
+    height = 1 + std::max(leftHeight, rightHeight);
+    rebuildNode(node, leftHeight, rightHeight);
+    return node;
+}
+
+/**
+* Splits the nodes, in key order, into live ones and tombstones with an explicit stack
+* (iterators would skip the tombstones), then rebuilds without the tombstones.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::purgeErased()
+{
+    if (mErasedNodes == 0) {
+        return;
+    }
+    std::vector<Node<Key, Value>*> survivors;
+    std::vector<Node<Key, Value>*> victims;
+    survivors.reserve(mSize);
+    victims.reserve(mErasedNodes);
+    std::vector<Node<Key, Value>*> stack;
+    Node<Key, Value>* n = mRoot;
+    while (n != NULL || !stack.empty()) {
+        while (n != NULL) {
+            stack.push_back(n);
+            n = n->getLeft();
+        }
+        n = stack.back();
+        stack.pop_back();
+        if (n->isErased()) {
+            victims.push_back(n);
+        }
+        else {
+            survivors.push_back(n);
+        }
+        n = n->getRight();
+    }
+    rebuildWithout(survivors, victims);
+}
+
+/**
+* Frees the victims and relinks the (sorted) survivors into a balanced tree. O(n).
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::rebuildWithout(std::vector<Node<Key, Value>*>& survivors, std::vector<Node<Key, Value>*>& victims)
+{
+    flushUpdates();
+    for (size_t i = 0; i < victims.size(); ++i) {
+        destroyNode(victims[i]);
+    }
+    int height;
+    mRoot = buildBalanced(survivors, 0, survivors.size(), NULL, height);
+}
+
+/**
+* Day-Stout-Warren: right rotations straighten the tree into a sorted "vine" of right
+* children, then rounds of left rotations along the vine fold it into a balanced tree.
+* The first round places the nodes that do not fill a complete tree as the bottom
+* level. Derived trees then get rebuildNode on every node, bottom-up; the tree is
+* balanced by then, so that pass only recurses O(log n) deep.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::rebalance()
+{
+    flushUpdates();
+    size_t count = treeToVine();
+    size_t complete = 1;
+    while (complete * 2 <= count + 1) {
+        complete *= 2;
+    }
+    size_t bottom = count + 1 - complete;
+    compressVine(bottom);
+    size_t spine = count - bottom;
+    while (spine > 1) {
+        spine /= 2;
+        compressVine(spine);
+    }
+    int height;
+    restoreNodes(mRoot, height);
+}
+
+/**
+* Purges tombstones rather than copy them, relocates the nodes, then empties the find
+* cache, whose entries point at the old ones. The size and the miss filter depend only
+* on the keys, so they stay as they are.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::compact()
+{
+    purgeErased();
+    compactNodes();
+    std::fill(mFindCache.begin(), mFindCache.end(), FindCacheBucket());
+}
+
+/**
+* Bulk build. Nodes are made in key order and linked by buildBalanced, with no
+* comparisons at all; if making one throws, the ones already made are freed. The miss
+* filter is suspended meanwhile: a rebuild triggered by growth would walk mRoot, which
+* holds none of the new nodes yet. It is rebuilt once, at the end.
+*/
+template<typename Key, typename Value, typename Allocator>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Allocator>::assignSorted(InputIt first, InputIt last)
+{
+    clear();
+    bool missFilterOn = mMissFilterOn;
+    mMissFilterOn = false;
+    std::vector<Node<Key, Value>*> nodes;
+    try {
+        for (; first != last; ++first) {
+            Node<Key, Value>* node = createDetachedNode(first->first, first->second);
+            try {
+                nodes.push_back(node);
+            }
+            catch (...) {
+                destroyNode(node);
+                throw;
+            }
+        }
+    }
+    catch (...) {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            destroyNode(nodes[i]);
+        }
+        if (missFilterOn) {
+            rebuildMissFilter(1024);
+        }
+        throw;
+    }
+    int height;
+    mRoot = buildBalanced(nodes, 0, nodes.size(), NULL, height);
+    if (missFilterOn) {
+        rebuildMissFilter(std::max((size_t)1024, 2 * mSize));
+    }
+}
+
+/**
+* Makes an unlinked plain Node.
+*/
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::createDetachedNode(const Key& key, const Value& value)
+{
+    return createNode(key, value, NULL);
+}
+
+/**
+* Rotates right at every node with a left child until none is left, turning the tree
+* into a chain of right children in key order. Each rotation moves one node onto the
+* vine for good, so this is O(n). Returns the number of nodes.
+*/
+template<typename Key, typename Value, typename Allocator>
+size_t BinarySearchTree<Key, Value, Allocator>::treeToVine()
+{
+    Node<Key, Value>* tail = NULL;
+    Node<Key, Value>* rest = mRoot;
+    size_t count = 0;
+    while (rest != NULL) {
+        Node<Key, Value>* left = rest->getLeft();
+        if (left == NULL) {
+            tail = rest;
+            rest = rest->getRight();
+            ++count;
+            continue;
+        }
+        rest->setLeft(left->getRight());
+        if (left->getRight() != NULL) {
+            left->getRight()->setParent(rest);
+        }
+        left->setRight(rest);
+        rest->setParent(left);
+        left->setParent(tail);
+        replaceChild(tail, rest, left);
+        rest = left;
+    }
+    return count;
+}
+
+/**
+* Left-rotates every other node down the right spine, rotations times, halving the
+* spine's length.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::compressVine(size_t rotations)
+{
+    Node<Key, Value>* scanner = NULL;
+    for (size_t i = 0; i < rotations; ++i) {
+        Node<Key, Value>* child = (scanner == NULL) ? mRoot : scanner->getRight();
+        Node<Key, Value>* grandchild = child->getRight();
+        child->setRight(grandchild->getLeft());
+        if (grandchild->getLeft() != NULL) {
+            grandchild->getLeft()->setParent(child);
+        }
+        grandchild->setLeft(child);
+        child->setParent(grandchild);
+        grandchild->setParent(scanner);
+        replaceChild(scanner, child, grandchild);
+        scanner = grandchild;
+    }
+}
+
+/**
+* Post-order pass calling rebuildNode with each node's subtree heights.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::restoreNodes(Node<Key, Value>* node, int& height)
+{
+    if (node == NULL) {
+        height = 0;
+        return;
+    }
+    int leftHeight, rightHeight;
+    restoreNodes(node->getLeft(), leftHeight);
+    restoreNodes(node->getRight(), rightHeight);
+    height = 1 + std::max(leftHeight, rightHeight);
+    rebuildNode(node, leftHeight, rightHeight);
+}
+
+/**
+* A plain BST relocates plain Nodes.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::compactNodes()
+{
+    relocateNodes<Node<Key, Value> >();
+}
+
+/**
+* Copies every node into a single allocation in van Emde Boas order. Each old node's
+* parent link is then pointed at its copy, so the copies' links, which still name old
+* nodes, are forwarded in one pass without a lookup table. If a copy throws, the new
+* block is released and the tree is untouched. The old nodes are freed without the
+* nodeDestroyed bookkeeping, since every key is still in the tree.
+*/
+template<typename Key, typename Value, typename Allocator>
+template<typename NodeType>
+void BinarySearchTree<Key, Value, Allocator>::relocateNodes()
+{
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<NodeType> NodeAllocator;
+    typedef std::allocator_traits<NodeAllocator> NodeTraits;
+    if (mRoot == NULL) {
+        return;
+    }
+    std::vector<Node<Key, Value>*> order;
+    order.reserve(mSize);
+    vanEmdeBoasOrder(mRoot, levelCount(mRoot), order);
+
+    NodeAllocator allocator(mAllocator);
+    size_t count = order.size();
+    NodeType* block = NodeTraits::allocate(allocator, count);
+    size_t built = 0;
+    try {
+        for (; built < count; ++built) {
+            NodeTraits::construct(allocator, block + built, *static_cast<NodeType*>(order[built]));
+        }
+    }
+    catch (...) {
+        while (built > 0) {
+            NodeTraits::destroy(allocator, block + --built);
+        }
+        NodeTraits::deallocate(allocator, block, count);
+        throw;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        order[i]->setParent(block + i);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        NodeType* copy = block + i;
+        Node<Key, Value>* parent = copy->getParent();
+        Node<Key, Value>* left = copy->getLeft();
+        Node<Key, Value>* right = copy->getRight();
+        copy->setParent((parent == NULL) ? NULL : parent->getParent());
+        copy->setLeft((left == NULL) ? NULL : left->getParent());
+        copy->setRight((right == NULL) ? NULL : right->getParent());
+    }
+    mRoot = block;
+    for (size_t i = 0; i < count; ++i) {
+        freeNode(static_cast<NodeType*>(order[i]));
+    }
+    mNodeBlock = block;
+    mNodeBlockSize = count;
+    mNodeBlockLive = count;
+}
+
+/**
+* Destroys node. A node inside the compact block only counts down the block's live
+* nodes, and the block is freed with the last of them; any other node is freed alone.
+*/
+template<typename Key, typename Value, typename Allocator>
+template<typename NodeType>
+void BinarySearchTree<Key, Value, Allocator>::freeNode(NodeType* node)
+{
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<NodeType> NodeAllocator;
+    typedef std::allocator_traits<NodeAllocator> NodeTraits;
+    NodeAllocator allocator(mAllocator);
+    NodeTraits::destroy(allocator, node);
+    NodeType* block = static_cast<NodeType*>(mNodeBlock);
+    std::less<const void*> before;
+    if (block == NULL || before(node, block) || !before(node, block + mNodeBlockSize)) {
+        NodeTraits::deallocate(allocator, node, 1);
+        return;
+    }
+    if (--mNodeBlockLive == 0) {
+        NodeTraits::deallocate(allocator, block, mNodeBlockSize);
+        mNodeBlock = NULL;
+        mNodeBlockSize = 0;
+    }
+}
+
+/**
+* The number of levels below root (its height), found without recursion, since a
+* plain BST may be a long chain.
+*/
+template<typename Key, typename Value, typename Allocator>
+int BinarySearchTree<Key, Value, Allocator>::levelCount(Node<Key, Value>* root)
+{
+    int levels = 0;
+    std::vector<std::pair<Node<Key, Value>*, int> > stack;
+    if (root != NULL) {
+        stack.push_back(std::make_pair(root, 1));
+    }
+    while (!stack.empty()) {
+        Node<Key, Value>* node = stack.back().first;
+        int level = stack.back().second;
+        stack.pop_back();
+        levels = std::max(levels, level);
+        if (node->getLeft() != NULL) {
+            stack.push_back(std::make_pair(node->getLeft(), level + 1));
+        }
+        if (node->getRight() != NULL) {
+            stack.push_back(std::make_pair(node->getRight(), level + 1));
+        }
+    }
+    return levels;
+}
+
+/**
+* Appends the nodes exactly depth edges below root, left to right.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::nodesAtDepth(Node<Key, Value>* root, int depth, std::vector<Node<Key, Value>*>& out)
+{
+    std::vector<std::pair<Node<Key, Value>*, int> > stack;
+    stack.push_back(std::make_pair(root, 0));
+    while (!stack.empty()) {
+        Node<Key, Value>* node = stack.back().first;
+        int nodeDepth = stack.back().second;
+        stack.pop_back();
+        if (nodeDepth == depth) {
+            out.push_back(node);
+            continue;
+        }
+        if (node->getRight() != NULL) {
+            stack.push_back(std::make_pair(node->getRight(), nodeDepth + 1));
+        }
+        if (node->getLeft() != NULL) {
+            stack.push_back(std::make_pair(node->getLeft(), nodeDepth + 1));
+        }
+    }
+}
+
+/**
+* Splits the levels in half: the top half is laid out recursively, followed by each
+* subtree hanging below it, left to right, each laid out recursively. Any run of
+* levels along a search path then sits in a few contiguous pieces, whatever the cache
+* line or page size. The recursion halves levels, so it is only O(log log n) deep.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::vanEmdeBoasOrder(Node<Key, Value>* root, int levels, std::vector<Node<Key, Value>*>& out)
+{
+    if (levels == 1) {
+        out.push_back(root);
+        return;
+    }
+    int top = levels / 2;
+    vanEmdeBoasOrder(root, top, out);
+    std::vector<Node<Key, Value>*> bottoms;
+    nodesAtDepth(root, top, bottoms);
+    for (size_t i = 0; i < bottoms.size(); ++i) {
+        vanEmdeBoasOrder(bottoms[i], levels - top, out);
+    }
+}
+
 /**
 * Helper function to print the tree's contents
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::printRoot (Node<Key, Value>* root) const
 {
     if (root != NULL)
     {
@@ -560,15 +1955,46 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 /**
 * Helper function to delete all the items
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::deleteAll (Node<Key, Value>* root)
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::deleteAll (Node<Key, Value>* root)
 {
     if (root != NULL)
     {
         deleteAll (root->getLeft());
         deleteAll (root->getRight());
-        delete root;
+        destroyNode (root);
+    }
+}
+
+/**
+* Allocates and constructs a node with the tree's allocator.
+*/
+template<typename Key, typename Value, typename Allocator>
+Node<Key, Value>* BinarySearchTree<Key, Value, Allocator>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Node<Key, Value> > NodeAllocator;
+    typedef std::allocator_traits<NodeAllocator> NodeTraits;
+    NodeAllocator allocator(mAllocator);
+    Node<Key, Value>* node = NodeTraits::allocate(allocator, 1);
+    try {
+        NodeTraits::construct(allocator, node, key, value, parent);
+    }
+    catch (...) {
+        NodeTraits::deallocate(allocator, node, 1);
+        throw;
     }
+    nodeCreated(node);
+    return node;
+}
+
+/**
+* Destroys a node made by createNode and returns its memory to the allocator.
+*/
+template<typename Key, typename Value, typename Allocator>
+void BinarySearchTree<Key, Value, Allocator>::destroyNode(Node<Key, Value>* node)
+{
+    nodeDestroyed(node);
+    freeNode(node);
 }
 
 /*
@@ -577,4 +2003,11 @@ End implementations for the BinarySearchTree class.
 ---------------------------------------------------
 */
 
+/**
+* Trees whose nodes come from a std::pmr::memory_resource, for example a per-request
+* monotonic_buffer_resource whose memory is released in bulk.
+*/
+template <typename Key, typename Value>
+using PmrBinarySearchTree = BinarySearchTree<Key, Value, std::pmr::polymorphic_allocator<std::pair<Key, Value> > >;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+#include "buffered-tree.h"
+#include "test-items.h"
+
+using namespace std;
+
+// The items forEach visits, in the order it visits them.
+vector<pair<int, long> > items(const BufferedTree<int, long>& tree)
+{
+    vector<pair<int, long> > result;
+    tree.forEach([&](const int& key, const long& value) { result.push_back(make_pair(key, value)); });
+    return result;
+}
+
+void test1(const char* msg)
+{
+    // random writes match std::map while buffered, after batched flushes and after merges
+    BufferedTree<int, long> tree(64);
+    map<int, long> expected;
+    mt19937 rng(50);
+    bool ok = true;
+    for (int i = 0; i < 30000; ++i) {
+        int key = rng() % 3000;
+        if (rng() % 4 == 0) {
+            tree.erase(key);
+            expected.erase(key);
+        }
+        else {
+            tree.insert(make_pair(key, (long)i));
+            expected[key] = i;
+        }
+        int probe = rng() % 3000;
+        long value = -1;
+        bool found = tree.find(probe, value);
+        map<int, long>::iterator want = expected.find(probe);
+        ok = ok && (want == expected.end() ? !found : (found && value == want->second));
+        ok = ok && tree.buffered() <= 64;
+        if (i % 5000 == 0) {
+            ok = ok && sameItems(items(tree), expected);
+        }
+    }
+    ok = ok && sameItems(items(tree), expected) && tree.size() == expected.size() && tree.buffered() == 0;
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // a buffer larger than the tree is merged; erases of absent keys are harmless
+    BufferedTree<int, long> tree(1000);
+    map<int, long> expected;
+    for (int i = 0; i < 500; ++i) {
+        tree.insert(make_pair(i * 2, (long)i));
+        expected[i * 2] = i;
+    }
+    tree.erase(7);
+    tree.erase(10);
+    expected.erase(10);
+    tree.insert(make_pair(10, 5L));
+    tree.erase(10);
+    bool ok = sameItems(items(tree), expected) && tree.buffered() == 501;
+    tree.flush();
+    ok = ok && tree.buffered() == 0 && sameItems(items(tree), expected) && tree.size() == 499;
+
+    for (int i = 0; i < 1000; i += 2) {
+        tree.erase(i);
+    }
+    long value;
+    ok = ok && tree.size() == 0 && !tree.find(4, value);
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+}
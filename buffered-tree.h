@@ -0,0 +1,306 @@
+#ifndef BUFFERED_TREE_H
+#define BUFFERED_TREE_H
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An ordered map that absorbs writes in a sorted buffer in front of an AVLTree, in the
+* manner of an LSM memtable. find consults the buffer first, so every operation sees the
+* latest write. When the buffer fills, it is applied to the tree in one batch.
+*
+* A batch is applied in key order, so consecutive descents share most of their path and
+* find it already in cache, instead of each random insert paying cache misses from the
+* root down. The larger the batch, the more they share, so the buffer is large and kept
+* in two levels to make writes cheap: a small sorted front that new keys are shifted
+* into, and a large sorted run that the front is merged into whenever it fills. A batch
+* that is large relative to the tree is merged with it instead: one in-order pass builds
+* the combined items, and assignSorted rebuilds the tree in O(n).
+*/
+template <class Key, class Value>
+class BufferedTree
+{
+public:
+    static const size_t DEFAULT_BUFFER_CAPACITY = 65536;
+
+    explicit BufferedTree(size_t bufferCapacity = DEFAULT_BUFFER_CAPACITY);
+
+    // Adds the item, or replaces the value of an existing key.
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void erase(const Key& key);
+    // Copies the value for key into value. Returns false if key is not present.
+    bool find(const Key& key, Value& value) const;
+    // Applies every buffered write to the tree.
+    void flush();
+    // Number of items. Flushes first: whether a buffered write adds or removes an item
+    // is only known once it reaches the tree.
+    size_t size();
+    // Number of writes waiting in the buffer.
+    size_t buffered() const { return mFront.size() + mRun.size(); }
+
+    // Calls fn(key, value) for every item in key order, merging the buffer with the tree
+    // on the fly rather than flushing.
+    template <typename Fn>
+    void forEach(Fn fn) const;
+
+private:
+    // A batch of at least 1/MERGE_DIVISOR of the tree is merged rather than applied.
+    static const size_t MERGE_DIVISOR = 8;
+
+    struct Write
+    {
+        Key key;
+        Value value;
+        bool erase;
+    };
+
+    // The write of key in level, or NULL.
+    static const Write* lookup(const std::vector<Write>& level, const Key& key);
+    // Index of the first write in level whose key is not less than key.
+    static size_t lowerBound(const std::vector<Write>& level, const Key& key);
+    void buffer(const Key& key, const Value& value, bool erase);
+    void mergeFront();
+    void merge();
+
+    AVLTree<Key, Value> mTree;
+    // Both sorted by key. A key has at most one write, in one of the two.
+    std::vector<Write> mFront;
+    std::vector<Write> mRun;
+    size_t mBufferCapacity;
+    size_t mFrontCapacity;
+};
+
+/*
+-------------------------------------------------
+Begin implementations for the BufferedTree class.
+-------------------------------------------------
+*/
+
+/**
+* Constructor. A new key shifts half the front on average, and every full front costs a
+* pass over the run, so the front holds about sqrt(capacity) writes to balance the two.
+* It is reserved up front, so new keys never reallocate it.
+*/
+template<typename Key, typename Value>
+BufferedTree<Key, Value>::BufferedTree(size_t bufferCapacity)
+    : mBufferCapacity(std::max(bufferCapacity, (size_t)1)),
+      mFrontCapacity(1)
+{
+    while (mFrontCapacity * mFrontCapacity < mBufferCapacity) {
+        ++mFrontCapacity;
+    }
+    mFront.reserve(mFrontCapacity);
+}
+
+/**
+* Buffers an insert.
+*/
+template<typename Key, typename Value>
+void BufferedTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    buffer(keyValuePair.first, keyValuePair.second, false);
+}
+
+/**
+* Buffers an erase. It replaces any buffered insert of the same key.
+*/
+template<typename Key, typename Value>
+void BufferedTree<Key, Value>::erase(const Key& key)
+{
+    buffer(key, Value(), true);
+}
+
+/**
+* The buffer holds the latest write of key, if there is one; otherwise the tree decides.
+*/
+template<typename Key, typename Value>
+bool BufferedTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    const Write* write = lookup(mFront, key);
+    if (write == NULL) {
+        write = lookup(mRun, key);
+    }
+    if (write != NULL) {
+        if (write->erase) {
+            return false;
+        }
+        value = write->value;
+        return true;
+    }
+    typename AVLTree<Key, Value>::iterator it = mTree.find(key);
+    if (it == mTree.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+/**
+* Applies the buffer in key order, or merges it when it is large next to the tree.
+*/
+template<typename Key, typename Value>
+void BufferedTree<Key, Value>::flush()
+{
+    mergeFront();
+    if (mRun.empty()) {
+        return;
+    }
+    if (mRun.size() * MERGE_DIVISOR >= mTree.size()) {
+        merge();
+    }
+    else {
+        for (size_t i = 0; i < mRun.size(); ++i) {
+            if (mRun[i].erase) {
+                mTree.erase(mRun[i].key);
+            }
+            else {
+                mTree.insert(std::make_pair(mRun[i].key, mRun[i].value));
+            }
+        }
+    }
+    mRun.clear();
+}
+
+template<typename Key, typename Value>
+size_t BufferedTree<Key, Value>::size()
+{
+    flush();
+    return mTree.size();
+}
+
+/**
+* Combines the two buffer levels, then walks the tree and the buffer side by side. Where
+* both hold a key, the buffered write wins: an insert replaces the value and an erase
+* hides the item.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void BufferedTree<Key, Value>::forEach(Fn fn) const
+{
+    std::vector<Write> buffer;
+    buffer.reserve(mFront.size() + mRun.size());
+    std::merge(mRun.begin(), mRun.end(), mFront.begin(), mFront.end(), std::back_inserter(buffer),
+        [](const Write& a, const Write& b) { return a.key < b.key; });
+    typename AVLTree<Key, Value>::iterator it = mTree.begin();
+    typename std::vector<Write>::const_iterator write = buffer.begin();
+    while (it != mTree.end() || write != buffer.end()) {
+        if (write == buffer.end() || (it != mTree.end() && it->first < write->key)) {
+            fn(it->first, it->second);
+            ++it;
+            continue;
+        }
+        if (it != mTree.end() && !(write->key < it->first)) {
+            ++it;
+        }
+        if (!write->erase) {
+            fn(write->key, write->value);
+        }
+        ++write;
+    }
+}
+
+/**
+* Exact-match search of one buffer level.
+*/
+template<typename Key, typename Value>
+const typename BufferedTree<Key, Value>::Write* BufferedTree<Key, Value>::lookup(const std::vector<Write>& level, const Key& key)
+{
+    size_t index = lowerBound(level, key);
+    if (index == level.size() || key < level[index].key) {
+        return NULL;
+    }
+    return &level[index];
+}
+
+/**
+* Binary search of one buffer level.
+*/
+template<typename Key, typename Value>
+size_t BufferedTree<Key, Value>::lowerBound(const std::vector<Write>& level, const Key& key)
+{
+    size_t lo = 0;
+    size_t count = level.size();
+    while (count > 0) {
+        size_t half = count / 2;
+        if (level[lo + half].key < key) {
+            lo += half + 1;
+            count -= half + 1;
+        }
+        else {
+            count = half;
+        }
+    }
+    return lo;
+}
+
+/**
+* Overwrites the buffered write of key in whichever level holds it. A new key is
+* shifted into the front, after flushing the buffer to the tree if it is at capacity,
+* or merging the front into the run if only the front is full.
+*/
+template<typename Key, typename Value>
+void BufferedTree<Key, Value>::buffer(const Key& key, const Value& value, bool erase)
+{
+    Write write = { key, value, erase };
+    size_t position = lowerBound(mFront, key);
+    if (position < mFront.size() && !(key < mFront[position].key)) {
+        mFront[position] = write;
+        return;
+    }
+    size_t runPosition = lowerBound(mRun, key);
+    if (runPosition < mRun.size() && !(key < mRun[runPosition].key)) {
+        mRun[runPosition] = write;
+        return;
+    }
+    if (mFront.size() + mRun.size() == mBufferCapacity) {
+        flush();
+        position = 0;
+    }
+    else if (mFront.size() == mFrontCapacity) {
+        mergeFront();
+        position = 0;
+    }
+    mFront.insert(mFront.begin() + position, write);
+}
+
+/**
+* Merges the front into the run. The two hold different keys, so this is a plain merge.
+*/
+template<typename Key, typename Value>
+void BufferedTree<Key, Value>::mergeFront()
+{
+    if (mFront.empty()) {
+        return;
+    }
+    size_t middle = mRun.size();
+    mRun.insert(mRun.end(), mFront.begin(), mFront.end());
+    std::inplace_merge(mRun.begin(), mRun.begin() + middle, mRun.end(),
+        [](const Write& a, const Write& b) { return a.key < b.key; });
+    mFront.clear();
+}
+
+/**
+* Merges the tree's items with the run (the front is empty by now), as forEach does,
+* and rebuilds the tree from the result with assignSorted.
+*/
+template<typename Key, typename Value>
+void BufferedTree<Key, Value>::merge()
+{
+    std::vector<std::pair<Key, Value> > items;
+    items.reserve(mTree.size() + mRun.size());
+    forEach([&](const Key& key, const Value& value) {
+        items.push_back(std::make_pair(key, value));
+    });
+    mTree.assignSorted(items.begin(), items.end());
+}
+
+/*
+-----------------------------------------------
+End implementations for the BufferedTree class.
+-----------------------------------------------
+*/
+
+#endif
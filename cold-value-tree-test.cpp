@@ -0,0 +1,66 @@
+#include <array>
+#include <iostream>
+#include <map>
+#include <string>
+#include "cold-value-tree.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    // values are found through the store, and an update keeps the key's slot
+    ColdValueTree<int, string> tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, string(i, 'v')));
+    }
+    size_t slot = tree.find(42)->second;
+    tree.insert(make_pair(42, string("answer")));
+    bool ok = tree.find(42)->second == slot && *tree.findValue(42) == "answer";
+    ok = ok && tree.findValue(100) == NULL && *tree.findValue(7) == "vvvvvvv";
+    ok = ok && tree.value(tree.find(3)) == "vvv" && tree.validate() && tree.size() == 100;
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // every removal path frees its slot for reuse, so the store does not grow
+    ColdValueTree<int, array<char, 256> > tree;
+    map<int, char> expected;
+    array<char, 256> value;
+    for (int i = 0; i < 1000; ++i) {
+        value.fill((char)i);
+        tree.insert(make_pair(i, value));
+        expected[i] = (char)i;
+    }
+    tree.erase(5);
+    tree.erase(tree.find(10));
+    tree.erase(tree.find(100), tree.find(400));
+    tree.erase_if([](const pair<int, size_t>& item) { return item.first % 2 == 1; });
+    for (map<int, char>::iterator it = expected.begin(); it != expected.end(); ) {
+        if (it->first == 5 || it->first == 10 || (it->first >= 100 && it->first < 400) || it->first % 2 == 1) {
+            it = expected.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    size_t highest = 0;
+    for (int i = 1000; i < 1000 + 1000 - (int)expected.size(); ++i) {
+        value.fill((char)i);
+        tree.insert(make_pair(i, value));
+        expected[i] = (char)i;
+        highest = max(highest, tree.find(i)->second);
+    }
+    bool ok = highest < 1000 && tree.size() == expected.size();
+    for (map<int, char>::iterator it = expected.begin(); it != expected.end(); ++it) {
+        const array<char, 256>* found = tree.findValue(it->first);
+        ok = ok && found != NULL && (*found)[0] == it->second && (*found)[255] == it->second;
+    }
+    cout << msg << ": " << (ok && tree.validate()) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+}
@@ -0,0 +1,185 @@
+#ifndef COLD_VALUE_TREE_H
+#define COLD_VALUE_TREE_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* An AVL tree that keeps its values out of line. Each node holds only its key, its links
+* and the index of its value in one contiguous value store, so a node is the same small
+* size however large Value is. A lookup touches only these compact nodes on the way
+* down, which keeps many more levels of the tree in cache, and reads a value once, at
+* the match.
+*
+* Iterating yields (key, index) items; use value(it) to reach the value. The index must
+* not be modified. Every removal path (erase, erase_if, clear) returns the value's slot
+* to a free list that later inserts reuse.
+*/
+template <class Key, class Value, class Allocator = std::allocator<std::pair<Key, Value> > >
+class ColdValueTree : public AVLTree<Key, size_t, NoAggregate<size_t>, typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<Key, size_t> > >
+{
+public:
+    typedef AVLTree<Key, size_t, NoAggregate<size_t>, typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<Key, size_t> > > Base;
+    typedef typename Base::iterator iterator;
+
+    explicit ColdValueTree(const Allocator& allocator = Allocator());
+    virtual ~ColdValueTree();
+
+    // Adds key with value, or replaces the value of a key already present.
+    void insert(const std::pair<Key, Value>& keyValuePair);
+
+    // Returns the value stored for key, or NULL if key is not present.
+    Value* findValue(const Key& key);
+    const Value* findValue(const Key& key) const;
+    // The value of the item it points to.
+    Value& value(iterator it);
+    const Value& value(iterator it) const;
+
+protected:
+    // Releases the node's value slot before freeing the node.
+    virtual void destroyNode(Node<Key, size_t>* node) override;
+
+private:
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Value> ValueAllocator;
+
+    // Items would bypass the value store, so bulk building is not offered.
+    using Base::assignSorted;
+
+    size_t acquireSlot(const Value& value);
+    void releaseSlot(size_t slot);
+
+    std::vector<Value, ValueAllocator> mValues;
+    // Slots of mValues that no node refers to.
+    std::vector<size_t> mFreeSlots;
+};
+
+/*
+--------------------------------------------------
+Begin implementations for the ColdValueTree class.
+--------------------------------------------------
+*/
+
+/**
+* Constructor. Nodes and values both come from allocator, rebound to their types.
+*/
+template<typename Key, typename Value, typename Allocator>
+ColdValueTree<Key, Value, Allocator>::ColdValueTree(const Allocator& allocator)
+    : Base(typename Base::allocator_type(allocator)),
+      mValues(ValueAllocator(allocator))
+{
+
+}
+
+/**
+* Destructor. Frees the nodes here, while destroyNode still resolves to this class and
+* the value store still exists.
+*/
+template<typename Key, typename Value, typename Allocator>
+ColdValueTree<Key, Value, Allocator>::~ColdValueTree()
+{
+    this->clear();
+}
+
+/**
+* Inserts or updates an item. An existing key keeps its slot and only the value is
+* assigned, so no node is touched. A tombstone left by a lazy erase still owns its
+* slot, so it is revived with the same one.
+*/
+template<typename Key, typename Value, typename Allocator>
+void ColdValueTree<Key, Value, Allocator>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    Node<Key, size_t>* node = this->internalFind(keyValuePair.first);
+    if (node != NULL) {
+        mValues[node->getValue()] = keyValuePair.second;
+        if (node->isErased()) {
+            Base::insert(std::make_pair(keyValuePair.first, node->getValue()));
+        }
+        return;
+    }
+    size_t slot = acquireSlot(keyValuePair.second);
+    try {
+        Base::insert(std::make_pair(keyValuePair.first, slot));
+    }
+    catch (...) {
+        releaseSlot(slot);
+        throw;
+    }
+}
+
+/**
+* Looks up key through the key-only nodes and reads the value store once.
+*/
+template<typename Key, typename Value, typename Allocator>
+Value* ColdValueTree<Key, Value, Allocator>::findValue(const Key& key)
+{
+    Node<Key, size_t>* node = this->internalFind(key);
+    return (node == NULL || node->isErased()) ? NULL : &mValues[node->getValue()];
+}
+
+template<typename Key, typename Value, typename Allocator>
+const Value* ColdValueTree<Key, Value, Allocator>::findValue(const Key& key) const
+{
+    Node<Key, size_t>* node = this->internalFind(key);
+    return (node == NULL || node->isErased()) ? NULL : &mValues[node->getValue()];
+}
+
+/**
+* Follows an item's index into the value store.
+*/
+template<typename Key, typename Value, typename Allocator>
+Value& ColdValueTree<Key, Value, Allocator>::value(iterator it)
+{
+    return mValues[it->second];
+}
+
+template<typename Key, typename Value, typename Allocator>
+const Value& ColdValueTree<Key, Value, Allocator>::value(iterator it) const
+{
+    return mValues[it->second];
+}
+
+/**
+* Releases the value slot, then frees the node as AVLTree does.
+*/
+template<typename Key, typename Value, typename Allocator>
+void ColdValueTree<Key, Value, Allocator>::destroyNode(Node<Key, size_t>* node)
+{
+    releaseSlot(node->getValue());
+    Base::destroyNode(node);
+}
+
+/**
+* Stores value in a free slot, or at the end of the store if there is none.
+*/
+template<typename Key, typename Value, typename Allocator>
+size_t ColdValueTree<Key, Value, Allocator>::acquireSlot(const Value& value)
+{
+    if (mFreeSlots.empty()) {
+        mValues.push_back(value);
+        return mValues.size() - 1;
+    }
+    size_t slot = mFreeSlots.back();
+    mValues[slot] = value;
+    mFreeSlots.pop_back();
+    return slot;
+}
+
+/**
+* Resets a slot's value (so it frees whatever it owns) and makes the slot reusable.
+*/
+template<typename Key, typename Value, typename Allocator>
+void ColdValueTree<Key, Value, Allocator>::releaseSlot(size_t slot)
+{
+    mValues[slot] = Value();
+    mFreeSlots.push_back(slot);
+}
+
+/*
+------------------------------------------------
+End implementations for the ColdValueTree class.
+------------------------------------------------
+*/
+
+#endif
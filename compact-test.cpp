@@ -0,0 +1,155 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+#include "cold-value-tree.h"
+#include "scapegoat-tree.h"
+
+using namespace std;
+
+// Keys in pre-order, which pins down the shape as well as the contents.
+template <typename Key, typename Value>
+void preorder(Node<Key, Value>* node, vector<Key>& out)
+{
+    if (node != NULL) {
+        out.push_back(node->getKey());
+        preorder(node->getLeft(), out);
+        preorder(node->getRight(), out);
+    }
+}
+
+// True if every node below node lies in the array of count NodeTypes at first.
+template <typename NodeType, typename Key, typename Value>
+bool inBlock(Node<Key, Value>* node, const NodeType* first, size_t count)
+{
+    if (node == NULL) {
+        return true;
+    }
+    const NodeType* n = static_cast<const NodeType*>(node);
+    return n >= first && n < first + count
+            && inBlock<NodeType>(node->getLeft(), first, count) && inBlock<NodeType>(node->getRight(), first, count);
+}
+
+void test1(const char* msg)
+{
+    // after churn, compact keeps the shape, puts the root first and every node in one block
+    AVLTree<int, int> tree;
+    tree.setFindCache(256);
+    tree.setMissFilter(true);
+    map<int, int> expected;
+    mt19937 rng(7);
+    for (int i = 0; i < 20000; ++i) {
+        int key = rng() % 5000;
+        if (rng() % 3 == 0) {
+            tree.erase(key);
+            expected.erase(key);
+        }
+        else {
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+        }
+        tree.find(key / 2);
+    }
+    vector<int> before, after;
+    preorder(tree.mRoot, before);
+    tree.compact();
+    preorder(tree.mRoot, after);
+    typedef AVLNode<int, int, NoAggregate<int> > AVLIntNode;
+    const AVLIntNode* first = static_cast<const AVLIntNode*>(tree.mRoot);
+    bool ok = before == after && tree.validate() && tree.size() == expected.size();
+    ok = ok && inBlock<AVLIntNode>(tree.mRoot, first, tree.size());
+    for (int key = -10; key < 5010; ++key) {
+        map<int, int>::iterator want = expected.find(key);
+        AVLTree<int, int>::iterator got = tree.find(key);
+        ok = ok && (want == expected.end() ? got == tree.end() : (got != tree.end() && got->second == want->second));
+    }
+
+    // the tree keeps working: new nodes are allocated singly, block nodes freed as erased
+    for (int key = 0; key < 6000; key += 2) {
+        tree.erase(key);
+        expected.erase(key);
+        tree.insert(make_pair(key + 1, -key));
+        expected[key + 1] = -key;
+    }
+    tree.compact();
+    tree.compact();
+    ok = ok && tree.validate() && tree.size() == expected.size();
+    map<int, int>::iterator want = expected.begin();
+    for (AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it, ++want) {
+        ok = ok && it->first == want->first && it->second == want->second;
+    }
+    tree.clear();
+    tree.compact();
+    ok = ok && tree.empty() && tree.find(1) == tree.end();
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // van Emde Boas order: a perfect tree of four levels is stored as its top two levels,
+    // then each of the four three-node subtrees below them
+    BinarySearchTree<int, int> tree;
+    int keys[] = { 8, 4, 12, 2, 6, 10, 14, 1, 3, 5, 7, 9, 11, 13, 15 };
+    for (size_t i = 0; i < 15; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    tree.compact();
+    Node<int, int>* block = tree.mRoot;
+    int layout[] = { 8, 4, 12, 2, 1, 3, 6, 5, 7, 10, 9, 11, 14, 13, 15 };
+    bool ok = tree.validate();
+    for (size_t i = 0; i < 15; ++i) {
+        ok = ok && block[i].getKey() == layout[i];
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test3(const char* msg)
+{
+    // other node types: a long plain chain, a scapegoat tree, cold values, pending range updates
+    BinarySearchTree<int, int> chain;
+    for (int i = 0; i < 20000; ++i) {
+        chain.insert(make_pair(i, i));
+    }
+    chain.compact();
+    bool ok = chain.validate() && chain.size() == 20000 && inBlock<Node<int, int> >(chain.mRoot, chain.mRoot, 20000);
+
+    ScapegoatTree<int, int> scapegoat;
+    for (int i = 0; i < 3000; ++i) {
+        scapegoat.insert(make_pair((i * 7919) % 3000, i));
+    }
+    scapegoat.compact();
+    for (int i = 0; i < 2500; ++i) {
+        scapegoat.erase(i);
+    }
+    ok = ok && scapegoat.validate() && scapegoat.size() == 500;
+
+    ColdValueTree<int, string> cold;
+    for (int i = 0; i < 1000; ++i) {
+        cold.insert(make_pair(i, string(i % 50, 'x')));
+    }
+    cold.compact();
+    for (int i = 0; i < 1000; i += 3) {
+        cold.erase(i);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        const string* value = cold.findValue(i);
+        ok = ok && (i % 3 == 0 ? value == NULL : (value != NULL && *value == string(i % 50, 'x')));
+    }
+
+    AVLTree<int, long, RangeAddAggregate<long> > sums;
+    for (int i = 0; i < 1000; ++i) {
+        sums.insert(make_pair(i, (long)i));
+    }
+    sums.updateRange(100, 600, 5L);
+    long before = sums.aggregate(0, 999).sum;
+    sums.compact();
+    ok = ok && sums.validate() && sums.aggregate(0, 999).sum == before && sums.find(300)->second == 305;
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+}
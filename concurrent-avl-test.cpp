@@ -0,0 +1,111 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "concurrent-avl.h"
+
+using namespace std;
+
+// Runs fn(threadIndex) on threads threads.
+template <typename Fn>
+void runThreads(int threads, Fn fn)
+{
+    vector<thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(thread(fn, t));
+    }
+    for (int t = 0; t < threads; ++t) {
+        workers[t].join();
+    }
+}
+
+bool contentsAre(const ConcurrentAVLTree<int, int>& tree, const vector<int>& keys)
+{
+    vector<int> seen;
+    bool valuesOk = true;
+    tree.forEach([&](const int& key, const int& value) {
+        seen.push_back(key);
+        valuesOk = valuesOk && value == key * 10;
+    });
+    return valuesOk && seen == keys && tree.size() == keys.size();
+}
+
+void test1(const char* msg)
+{
+    ConcurrentAVLTree<int, int> tree;
+    runThreads(4, [&](int t) {
+        for (int i = t; i < 20000; i += 4) {
+            tree.insert(make_pair(i, i * 10));
+        }
+    });
+    vector<int> expected;
+    for (int i = 0; i < 20000; ++i) {
+        expected.push_back(i);
+    }
+    cout << msg << ": " << contentsAre(tree, expected) << endl;
+}
+
+void test2(const char* msg)
+{
+    ConcurrentAVLTree<int, int> tree;
+    for (int i = 0; i < 20000; ++i) {
+        tree.insert(make_pair(i, i * 10));
+    }
+    // two threads erase the odd keys while two readers look up even keys, which must
+    // always be found
+    bool readersOk = true;
+    runThreads(4, [&](int t) {
+        if (t < 2) {
+            for (int i = 1 + 2 * t; i < 20000; i += 4) {
+                tree.erase(i);
+            }
+        }
+        else {
+            int value;
+            for (int round = 0; round < 3; ++round) {
+                for (int i = 0; i < 20000; i += 2) {
+                    if (!tree.find(i, value) || value != i * 10) {
+                        readersOk = false;
+                    }
+                }
+            }
+        }
+    });
+    vector<int> expected;
+    for (int i = 0; i < 20000; i += 2) {
+        expected.push_back(i);
+    }
+    cout << msg << ": " << (readersOk && contentsAre(tree, expected)) << endl;
+}
+
+void test3(const char* msg)
+{
+    // every thread churns its own residue class; afterwards each keeps the keys it
+    // inserted last
+    ConcurrentAVLTree<int, int> tree;
+    runThreads(4, [&](int t) {
+        for (int round = 0; round < 5; ++round) {
+            for (int i = t; i < 4000; i += 4) {
+                tree.insert(make_pair(i, i * 10));
+            }
+            for (int i = t; i < 4000; i += 4) {
+                if (round < 4 || i % 3 != 0) {
+                    tree.erase(i);
+                }
+            }
+        }
+    });
+    vector<int> expected;
+    for (int i = 0; i < 4000; i += 3) {
+        expected.push_back(i);
+    }
+    int value;
+    bool ok = contentsAre(tree, expected) && tree.find(3, value) && !tree.find(4, value);
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+}
@@ -0,0 +1,1220 @@
+#ifndef CONCURRENT_AVL_H
+#define CONCURRENT_AVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+* Epoch-based memory reclamation shared by every concurrent tree in the process.
+*
+* A thread announces the current global epoch while it is inside a Guard. Memory that
+* has been unlinked is retired together with the epoch at which it was retired, and is
+* only freed once the global epoch has advanced twice past that point. The epoch can only
+* advance when every thread inside a Guard has announced the current epoch, so by then no
+* thread can still be holding a pointer to the retired memory.
+*/
+class EpochReclaimer
+{
+public:
+    // Marks the calling thread as active for the lifetime of the guard.
+    class Guard
+    {
+    public:
+        Guard();
+        ~Guard();
+
+    private:
+        Guard(const Guard&);
+        Guard& operator=(const Guard&);
+    };
+
+    static EpochReclaimer& instance();
+
+    // Frees ptr with deleter once no thread can still be reading it.
+    void retire(void* ptr, void (*deleter)(void*));
+
+    ~EpochReclaimer();
+
+private:
+    struct Retired
+    {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    struct ThreadRecord
+    {
+        std::atomic<uint64_t> announced; // 0 while outside a Guard
+        std::atomic<bool> inUse;
+        unsigned nesting;
+        std::vector<Retired> limbo;
+        ThreadRecord* next;
+    };
+
+    // Claims a thread record when a thread first uses the reclaimer, and gives it back
+    // when the thread exits so the next thread can reuse it (and its limbo list).
+    struct RecordHandle
+    {
+        ThreadRecord* record;
+        RecordHandle() : record(EpochReclaimer::instance().acquireRecord()) {}
+        ~RecordHandle() { record->inUse.store(false); }
+    };
+
+    EpochReclaimer() : mEpoch(1), mRecords(NULL) {}
+
+    static ThreadRecord* localRecord();
+    ThreadRecord* acquireRecord();
+    bool tryAdvance();
+    void collect(ThreadRecord* record);
+
+    static const size_t COLLECT_THRESHOLD = 128;
+
+    std::atomic<uint64_t> mEpoch;
+    std::atomic<ThreadRecord*> mRecords;
+};
+
+/*
+------------------------------------------------
+Begin implementations for the EpochReclaimer class.
+------------------------------------------------
+*/
+
+/**
+* Returns the process-wide reclaimer.
+*/
+inline EpochReclaimer& EpochReclaimer::instance()
+{
+    static EpochReclaimer reclaimer;
+    return reclaimer;
+}
+
+/**
+* Frees everything still in limbo. Runs at exit, when no thread is inside a Guard.
+*/
+inline EpochReclaimer::~EpochReclaimer()
+{
+    ThreadRecord* record = mRecords.load();
+    while (record != NULL) {
+        for (size_t i = 0; i < record->limbo.size(); ++i) {
+            record->limbo[i].deleter(record->limbo[i].ptr);
+        }
+        ThreadRecord* next = record->next;
+        delete record;
+        record = next;
+    }
+}
+
+/**
+* Returns the calling thread's record.
+*/
+inline EpochReclaimer::ThreadRecord* EpochReclaimer::localRecord()
+{
+    static thread_local RecordHandle handle;
+    return handle.record;
+}
+
+/**
+* Reuses a record left behind by an exited thread, or pushes a new one onto the list.
+*/
+inline EpochReclaimer::ThreadRecord* EpochReclaimer::acquireRecord()
+{
+    for (ThreadRecord* record = mRecords.load(); record != NULL; record = record->next) {
+        bool expected = false;
+        if (!record->inUse.load() && record->inUse.compare_exchange_strong(expected, true)) {
+            return record;
+        }
+    }
+
+    ThreadRecord* record = new ThreadRecord;
+    record->announced.store(0);
+    record->inUse.store(true);
+    record->nesting = 0;
+    record->next = mRecords.load();
+    while (!mRecords.compare_exchange_weak(record->next, record)) {
+    }
+    return record;
+}
+
+/**
+* Enters a critical section by announcing the current epoch.
+*/
+inline EpochReclaimer::Guard::Guard()
+{
+    ThreadRecord* record = localRecord();
+    if (record->nesting++ == 0) {
+        record->announced.store(EpochReclaimer::instance().mEpoch.load());
+    }
+}
+
+/**
+* Leaves the critical section.
+*/
+inline EpochReclaimer::Guard::~Guard()
+{
+    ThreadRecord* record = localRecord();
+    if (--record->nesting == 0) {
+        record->announced.store(0);
+    }
+}
+
+/**
+* Adds ptr to the calling thread's limbo list, occasionally trying to advance the epoch
+* and free what has become safe.
+*/
+inline void EpochReclaimer::retire(void* ptr, void (*deleter)(void*))
+{
+    ThreadRecord* record = localRecord();
+    Retired retired = {ptr, deleter, mEpoch.load()};
+    record->limbo.push_back(retired);
+    if (record->limbo.size() >= COLLECT_THRESHOLD) {
+        tryAdvance();
+        collect(record);
+    }
+}
+
+/**
+* Moves the global epoch forward if every active thread has caught up with it.
+*/
+inline bool EpochReclaimer::tryAdvance()
+{
+    uint64_t epoch = mEpoch.load();
+    for (ThreadRecord* record = mRecords.load(); record != NULL; record = record->next) {
+        uint64_t announced = record->announced.load();
+        if (announced != 0 && announced != epoch) {
+            return false;
+        }
+    }
+    return mEpoch.compare_exchange_strong(epoch, epoch + 1);
+}
+
+/**
+* Frees the entries of record's limbo list that are at least two epochs old.
+*/
+inline void EpochReclaimer::collect(ThreadRecord* record)
+{
+    uint64_t epoch = mEpoch.load();
+    size_t kept = 0;
+    for (size_t i = 0; i < record->limbo.size(); ++i) {
+        if (record->limbo[i].epoch + 2 <= epoch) {
+            record->limbo[i].deleter(record->limbo[i].ptr);
+        }
+        else {
+            record->limbo[kept++] = record->limbo[i];
+        }
+    }
+    record->limbo.resize(kept);
+}
+
+/*
+----------------------------------------------
+End implementations for the EpochReclaimer class.
+----------------------------------------------
+*/
+
+/**
+* A node of a ConcurrentAVLTree. Every field other than the key may be read without
+* holding the node's lock, so they are all atomics.
+*
+* version is an optimistic version number that changes whenever the node's key range
+* shrinks (it is rotated down) or it is unlinked. Readers record it before following a
+* child pointer and check it afterwards; if it changed, the child they read might no
+* longer lead to their key. A null value marks a routing node: a removed key that is
+* kept in place because it still has two children.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLNode
+{
+public:
+    ConcurrentAVLNode(const Key& key, Value* value, ConcurrentAVLNode<Key, Value>* parent);
+
+    ConcurrentAVLNode<Key, Value>* getChild(int dir) const;
+    void setChild(int dir, ConcurrentAVLNode<Key, Value>* child);
+    void lock();
+    void unlock();
+    // Waits for a rotation that started when version was ovl to finish.
+    void waitUntilShrinkCompleted(uint64_t ovl);
+
+    const Key key;
+    std::atomic<Value*> value;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> parent;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> left;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> right;
+    std::atomic<int> height;
+    std::atomic<uint64_t> version;
+
+private:
+    std::atomic<bool> mLocked;
+};
+
+/*
+------------------------------------------------------
+Begin implementations for the ConcurrentAVLNode class.
+------------------------------------------------------
+*/
+
+/**
+* Creates a leaf with height 1.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode(const Key& key, Value* value, ConcurrentAVLNode<Key, Value>* parent)
+    : key(key)
+    , value(value)
+    , parent(parent)
+    , left(NULL)
+    , right(NULL)
+    , height(1)
+    , version(0)
+    , mLocked(false)
+{
+
+}
+
+/**
+* Returns the left child for negative dir and the right child otherwise.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getChild(int dir) const
+{
+    return (dir < 0) ? left.load() : right.load();
+}
+
+/**
+* Sets the left child for negative dir and the right child otherwise.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::setChild(int dir, ConcurrentAVLNode<Key, Value>* child)
+{
+    if (dir < 0) {
+        left.store(child);
+    }
+    else {
+        right.store(child);
+    }
+}
+
+/**
+* Acquires the node's lock. Locks are only ever held for a handful of pointer writes, so
+* a spin lock that yields is enough.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::lock()
+{
+    while (mLocked.exchange(true, std::memory_order_acquire)) {
+        while (mLocked.load(std::memory_order_relaxed)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+* Releases the node's lock.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::unlock()
+{
+    mLocked.store(false, std::memory_order_release);
+}
+
+/**
+* Rotations are performed while holding the node's lock, so once spinning has not helped
+* we simply take the lock, which cannot succeed until the rotation is over.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLNode<Key, Value>::waitUntilShrinkCompleted(uint64_t ovl)
+{
+    if ((ovl & 2) == 0) {
+        return;
+    }
+    for (int tries = 0; tries < 100; ++tries) {
+        if (version.load() != ovl) {
+            return;
+        }
+    }
+    lock();
+    unlock();
+}
+
+/*
+----------------------------------------------------
+End implementations for the ConcurrentAVLNode class.
+----------------------------------------------------
+*/
+
+/**
+* A thread-safe AVL tree after Bronson, Casper, Chafi and Olukotun, "A Practical
+* Concurrent Binary Search Tree" (PPoPP 2010).
+*
+* find() takes no locks: it descends hand over hand, validating each node's version after
+* reading its child, and retries from the last valid node if a rotation got in the way.
+* insert() and erase() descend the same way and then lock only the nodes they change.
+* Rebalancing walks up from the damaged node and, like AVLTree::insertFix/removeFix,
+* repairs it with single or double rotations, locking just the parent, the node and the
+* child(ren) being rotated. Because the repair happens after the update is published,
+* balance is relaxed while writers are active and strict again once they finish.
+*
+* Erasing a key with two children only clears its value, leaving a routing node that is
+* unlinked once it has fewer than two children. Unlinked nodes and replaced values are
+* freed through the EpochReclaimer. Key must be default constructible.
+*/
+template <class Key, class Value>
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    ~ConcurrentAVLTree();
+
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void erase(const Key& key);
+    // Copies the value for key into value. Returns false if key is not present.
+    bool find(const Key& key, Value& value) const;
+    size_t size() const;
+
+    // Calls fn(key, value) for every item in key order. Not safe to call while other
+    // threads are writing.
+    template <typename Fn>
+    void forEach(Fn fn) const;
+
+private:
+    typedef ConcurrentAVLNode<Key, Value> CNode;
+
+    enum Result { RESULT_RETRY, RESULT_ABSENT, RESULT_PRESENT };
+
+    static const uint64_t UNLINKED = 1;
+    static const uint64_t SHRINKING = 2;
+    static const uint64_t SHRINK_COUNT_INCR = 4;
+
+    static const int UNLINK_REQUIRED = -1;
+    static const int REBALANCE_REQUIRED = -2;
+    static const int NOTHING_REQUIRED = -3;
+
+    static bool isShrinkingOrUnlinked(uint64_t ovl) { return (ovl & (SHRINKING | UNLINKED)) != 0; }
+    static bool isUnlinked(uint64_t ovl) { return (ovl & UNLINKED) != 0; }
+    static int compare(const Key& a, const Key& b) { return (a < b) ? -1 : ((b < a) ? 1 : 0); }
+    static int height(CNode* node) { return (node == NULL) ? 0 : node->height.load(); }
+    static void deleteNode(void* node) { delete static_cast<CNode*>(node); }
+    static void deleteValue(void* value) { delete static_cast<Value*>(value); }
+
+    Result attemptGet(const Key& key, CNode* node, int dir, uint64_t nodeOVL, Value& value) const;
+    Result update(const Key& key, Value* newValue);
+    Result attemptUpdate(const Key& key, Value* newValue, CNode* parent, CNode* node, uint64_t nodeOVL);
+    Result attemptNodeUpdate(Value* newValue, CNode* parent, CNode* node);
+    bool attemptUnlink_nl(CNode* parent, CNode* node);
+
+    int nodeCondition(CNode* node) const;
+    void fixHeightAndRebalance(CNode* node);
+    CNode* fixHeight_nl(CNode* node);
+    CNode* rebalance_nl(CNode* nParent, CNode* n);
+    CNode* rebalanceToRight_nl(CNode* nParent, CNode* n, CNode* nL, int hR0);
+    CNode* rebalanceToLeft_nl(CNode* nParent, CNode* n, CNode* nR, int hL0);
+    CNode* rotateRight_nl(CNode* nParent, CNode* n, CNode* nL, int hR, int hLL, CNode* nLR, int hLR);
+    CNode* rotateLeft_nl(CNode* nParent, CNode* n, CNode* nR, int hL, int hRR, CNode* nRL, int hRL);
+    CNode* rotateRightOverLeft_nl(CNode* nParent, CNode* n, CNode* nL, int hR, int hLL, CNode* nLR, int hLRL);
+    CNode* rotateLeftOverRight_nl(CNode* nParent, CNode* n, CNode* nR, int hL, int hRR, CNode* nRL, int hRLR);
+
+    void deleteAll(CNode* node);
+    template <typename Fn>
+    void forEachHelper(CNode* node, Fn& fn) const;
+
+    // Sentinel whose right child is the root. It never moves, so its version never changes.
+    mutable CNode mHolder;
+    std::atomic<long> mSize;
+};
+
+/*
+------------------------------------------------------
+Begin implementations for the ConcurrentAVLTree class.
+------------------------------------------------------
+*/
+
+/**
+* Creates an empty tree.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::ConcurrentAVLTree()
+    : mHolder(Key(), NULL, NULL)
+    , mSize(0)
+{
+
+}
+
+/**
+* Frees every node still linked into the tree. Nodes that were already unlinked belong to
+* the EpochReclaimer.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::~ConcurrentAVLTree()
+{
+    deleteAll(mHolder.right.load());
+}
+
+/**
+* Helper function to delete all the nodes and values in a subtree.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::deleteAll(CNode* node)
+{
+    if (node != NULL) {
+        deleteAll(node->left.load());
+        deleteAll(node->right.load());
+        delete node->value.load();
+        delete node;
+    }
+}
+
+/**
+* Inserts a new item or replaces the value of an existing one.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    EpochReclaimer::Guard guard;
+    if (update(keyValuePair.first, new Value(keyValuePair.second)) == RESULT_ABSENT) {
+        ++mSize;
+    }
+}
+
+/**
+* Removes key if it is present.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::erase(const Key& key)
+{
+    EpochReclaimer::Guard guard;
+    if (update(key, NULL) == RESULT_PRESENT) {
+        --mSize;
+    }
+}
+
+/**
+* Lock-free lookup. Starts at the holder, whose version never changes, and retries
+* whenever the validated descent reports that it was invalidated.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    EpochReclaimer::Guard guard;
+    while (true) {
+        Result result = attemptGet(key, &mHolder, 1, mHolder.version.load(), value);
+        if (result != RESULT_RETRY) {
+            return result == RESULT_PRESENT;
+        }
+    }
+}
+
+/**
+* Returns the number of items. Concurrent writers may make this momentarily stale.
+*/
+template<typename Key, typename Value>
+size_t ConcurrentAVLTree<Key, Value>::size() const
+{
+    return (size_t)mSize.load();
+}
+
+/**
+* In-order traversal. Requires that no other thread is writing.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void ConcurrentAVLTree<Key, Value>::forEach(Fn fn) const
+{
+    forEachHelper(mHolder.right.load(), fn);
+}
+
+/**
+* Visits the non-routing nodes of a subtree in order.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void ConcurrentAVLTree<Key, Value>::forEachHelper(CNode* node, Fn& fn) const
+{
+    if (node != NULL) {
+        forEachHelper(node->left.load(), fn);
+        Value* value = node->value.load();
+        if (value != NULL) {
+            fn(node->key, *value);
+        }
+        forEachHelper(node->right.load(), fn);
+    }
+}
+
+/**
+* Looks for key below node, which was reached in a state described by nodeOVL. The child
+* pointer is only trusted if node's version is unchanged after reading it; once the child
+* has itself been validated we no longer depend on node, so a failed validation further
+* down only restarts from the deepest node that is still valid.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptGet(
+        const Key& key, CNode* node, int dir, uint64_t nodeOVL, Value& value) const
+{
+    while (true) {
+        CNode* child = node->getChild(dir);
+        if (child == NULL) {
+            if (node->version.load() != nodeOVL) {
+                return RESULT_RETRY;
+            }
+            return RESULT_ABSENT;
+        }
+
+        int childCmp = compare(key, child->key);
+        if (childCmp == 0) {
+            Value* found = child->value.load();
+            if (found == NULL) {
+                return RESULT_ABSENT;
+            }
+            value = *found;
+            return RESULT_PRESENT;
+        }
+
+        uint64_t childOVL = child->version.load();
+        if (isShrinkingOrUnlinked(childOVL)) {
+            child->waitUntilShrinkCompleted(childOVL);
+            if (node->version.load() != nodeOVL) {
+                return RESULT_RETRY;
+            }
+        }
+        else if (child != node->getChild(dir)) {
+            if (node->version.load() != nodeOVL) {
+                return RESULT_RETRY;
+            }
+        }
+        else {
+            if (node->version.load() != nodeOVL) {
+                return RESULT_RETRY;
+            }
+            Result result = attemptGet(key, child, childCmp, childOVL, value);
+            if (result != RESULT_RETRY) {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+* Sets key's value to newValue, or removes key when newValue is NULL. Returns whether the
+* key was present beforehand. Takes ownership of newValue.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::update(
+        const Key& key, Value* newValue)
+{
+    while (true) {
+        Result result = attemptUpdate(key, newValue, NULL, &mHolder, mHolder.version.load());
+        if (result != RESULT_RETRY) {
+            return result;
+        }
+    }
+}
+
+/**
+* The update counterpart of attemptGet. A missing child means key is absent, in which
+* case we lock node, revalidate, and hang a new leaf off it.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptUpdate(
+        const Key& key, Value* newValue, CNode* parent, CNode* node, uint64_t nodeOVL)
+{
+    int cmp = (node == &mHolder) ? 1 : compare(key, node->key);
+    if (cmp == 0) {
+        return attemptNodeUpdate(newValue, parent, node);
+    }
+
+    while (true) {
+        CNode* child = node->getChild(cmp);
+        if (node->version.load() != nodeOVL) {
+            return RESULT_RETRY;
+        }
+
+        if (child == NULL) {
+            if (newValue == NULL) {
+                return RESULT_ABSENT;
+            }
+
+            CNode* damaged;
+            node->lock();
+            if (node->version.load() != nodeOVL) {
+                node->unlock();
+                return RESULT_RETRY;
+            }
+            if (node->getChild(cmp) != NULL) {
+                // lost a race with another insert; look again from here
+                node->unlock();
+                continue;
+            }
+            node->setChild(cmp, new CNode(key, newValue, node));
+            damaged = fixHeight_nl(node);
+            node->unlock();
+
+            fixHeightAndRebalance(damaged);
+            return RESULT_ABSENT;
+        }
+
+        uint64_t childOVL = child->version.load();
+        if (isShrinkingOrUnlinked(childOVL)) {
+            child->waitUntilShrinkCompleted(childOVL);
+        }
+        else if (child != node->getChild(cmp)) {
+            // the child changed before we could validate it; reread
+        }
+        else {
+            if (node->version.load() != nodeOVL) {
+                return RESULT_RETRY;
+            }
+            Result result = attemptUpdate(key, newValue, node, child, childOVL);
+            if (result != RESULT_RETRY) {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+* Updates or removes the value of node, which holds the key. A removal that leaves node
+* with fewer than two children unlinks it, which needs the parent locked as well.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::Result ConcurrentAVLTree<Key, Value>::attemptNodeUpdate(
+        Value* newValue, CNode* parent, CNode* node)
+{
+    if (newValue == NULL && node->value.load() == NULL) {
+        return RESULT_ABSENT;
+    }
+
+    if (newValue == NULL && (node->left.load() == NULL || node->right.load() == NULL)) {
+        Value* prev;
+        CNode* damaged;
+        parent->lock();
+        if (isUnlinked(parent->version.load()) || node->parent.load() != parent) {
+            parent->unlock();
+            return RESULT_RETRY;
+        }
+        node->lock();
+        prev = node->value.load();
+        if (prev == NULL) {
+            node->unlock();
+            parent->unlock();
+            return RESULT_ABSENT;
+        }
+        if (!attemptUnlink_nl(parent, node)) {
+            node->unlock();
+            parent->unlock();
+            return RESULT_RETRY;
+        }
+        node->unlock();
+        damaged = fixHeight_nl(parent);
+        parent->unlock();
+
+        EpochReclaimer::instance().retire(prev, deleteValue);
+        EpochReclaimer::instance().retire(node, deleteNode);
+        fixHeightAndRebalance(damaged);
+        return RESULT_PRESENT;
+    }
+
+    node->lock();
+    if (isUnlinked(node->version.load())) {
+        node->unlock();
+        return RESULT_RETRY;
+    }
+    if (newValue == NULL && (node->left.load() == NULL || node->right.load() == NULL)) {
+        // a child went away since we looked; this is now an unlink
+        node->unlock();
+        return RESULT_RETRY;
+    }
+    Value* prev = node->value.exchange(newValue);
+    node->unlock();
+
+    if (prev != NULL) {
+        EpochReclaimer::instance().retire(prev, deleteValue);
+    }
+    return (prev != NULL) ? RESULT_PRESENT : RESULT_ABSENT;
+}
+
+/**
+* Splices node (which must have at most one child) out from under parent. Both locks
+* must be held.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::attemptUnlink_nl(CNode* parent, CNode* node)
+{
+    CNode* parentL = parent->left.load();
+    CNode* parentR = parent->right.load();
+    if (parentL != node && parentR != node) {
+        return false;
+    }
+
+    CNode* left = node->left.load();
+    CNode* right = node->right.load();
+    if (left != NULL && right != NULL) {
+        return false;
+    }
+
+    CNode* splice = (left != NULL) ? left : right;
+    if (parentL == node) {
+        parent->left.store(splice);
+    }
+    else {
+        parent->right.store(splice);
+    }
+    if (splice != NULL) {
+        splice->parent.store(parent);
+    }
+
+    node->version.store(UNLINKED);
+    node->value.store(NULL);
+    return true;
+}
+
+/**
+* Returns what node needs: an unlink (routing node with a missing child), a rebalance,
+* nothing, or otherwise the corrected height.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::nodeCondition(CNode* node) const
+{
+    if (node == &mHolder) {
+        return NOTHING_REQUIRED;
+    }
+
+    CNode* nL = node->left.load();
+    CNode* nR = node->right.load();
+    if ((nL == NULL || nR == NULL) && node->value.load() == NULL) {
+        return UNLINK_REQUIRED;
+    }
+
+    int hN = node->height.load();
+    int hL0 = height(nL);
+    int hR0 = height(nR);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int bal = hL0 - hR0;
+    if (bal < -1 || bal > 1) {
+        return REBALANCE_REQUIRED;
+    }
+    return (hN != hNRepl) ? hNRepl : NOTHING_REQUIRED;
+}
+
+/**
+* Walks up from node repairing heights and balance until nothing is left to fix. Height
+* fixes lock only the node; rotations and unlinks lock the parent first and then the node.
+*
+* A rotation can hand back a damaged node below the new subtree root while the parent's
+* height is also stale, so the parent of every rotation is remembered and rechecked once
+* the walk from below runs out.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::fixHeightAndRebalance(CNode* node)
+{
+    std::vector<CNode*> pending;
+    while (true) {
+        if (node == NULL || node == &mHolder || isUnlinked(node->version.load())
+            || nodeCondition(node) == NOTHING_REQUIRED) {
+            if (pending.empty()) {
+                return;
+            }
+            node = pending.back();
+            pending.pop_back();
+            continue;
+        }
+
+        int condition = nodeCondition(node);
+        if (condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED) {
+            node->lock();
+            CNode* next = fixHeight_nl(node);
+            node->unlock();
+            node = next;
+        }
+        else {
+            CNode* nParent = node->parent.load();
+            nParent->lock();
+            if (!isUnlinked(nParent->version.load()) && node->parent.load() == nParent) {
+                node->lock();
+                CNode* next = rebalance_nl(nParent, node);
+                node->unlock();
+                nParent->unlock();
+                if (next != nParent) {
+                    pending.push_back(nParent);
+                }
+                node = next;
+            }
+            else {
+                nParent->unlock();
+            }
+        }
+    }
+}
+
+/**
+* Fixes node's height if that is all it needs. Returns the next node to look at: node
+* itself if it needs more than a height fix, its parent if its height changed, or NULL.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::fixHeight_nl(CNode* node)
+{
+    int condition = nodeCondition(node);
+    if (condition == REBALANCE_REQUIRED || condition == UNLINK_REQUIRED) {
+        return node;
+    }
+    if (condition == NOTHING_REQUIRED) {
+        return NULL;
+    }
+    node->height.store(condition);
+    return node->parent.load();
+}
+
+/**
+* Repairs n with nParent and n locked: unlinks a routing node, rotates, or fixes the
+* height. Returns the next damaged node.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::rebalance_nl(CNode* nParent, CNode* n)
+{
+    CNode* nL = n->left.load();
+    CNode* nR = n->right.load();
+    if ((nL == NULL || nR == NULL) && n->value.load() == NULL) {
+        if (attemptUnlink_nl(nParent, n)) {
+            EpochReclaimer::instance().retire(n, deleteNode);
+            return fixHeight_nl(nParent);
+        }
+        return n;
+    }
+
+    int hN = n->height.load();
+    int hL0 = height(nL);
+    int hR0 = height(nR);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int bal = hL0 - hR0;
+    if (bal > 1) {
+        return rebalanceToRight_nl(nParent, n, nL, hR0);
+    }
+    else if (bal < -1) {
+        return rebalanceToLeft_nl(nParent, n, nR, hL0);
+    }
+    else if (hNRepl != hN) {
+        n->height.store(hNRepl);
+        return fixHeight_nl(nParent);
+    }
+    return NULL;
+}
+
+/**
+* n's left subtree is too tall. Locks nL (and nLR for the zig-zag case) and rotates.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::rebalanceToRight_nl(
+        CNode* nParent, CNode* n, CNode* nL, int hR0)
+{
+    nL->lock();
+    int hL = nL->height.load();
+    if (hL - hR0 <= 1) {
+        nL->unlock();
+        return n; // someone else fixed it; look again
+    }
+
+    CNode* nLR = nL->right.load();
+    int hLL0 = height(nL->left.load());
+    int hLR0 = height(nLR);
+    if (hLL0 >= hLR0) { //zig zig
+        CNode* next = rotateRight_nl(nParent, n, nL, hR0, hLL0, nLR, hLR0);
+        nL->unlock();
+        return next;
+    }
+
+    nLR->lock();
+    int hLR = nLR->height.load();
+    if (hLL0 >= hLR) {
+        CNode* next = rotateRight_nl(nParent, n, nL, hR0, hLL0, nLR, hLR);
+        nLR->unlock();
+        nL->unlock();
+        return next;
+    }
+    int hLRL = height(nLR->left.load());
+    int b = hLL0 - hLRL;
+    if (b >= -1 && b <= 1 && !((hLL0 == 0 || hLRL == 0) && nL->value.load() == NULL)) { //zig zag
+        CNode* next = rotateRightOverLeft_nl(nParent, n, nL, hR0, hLL0, nLR, hLRL);
+        nLR->unlock();
+        nL->unlock();
+        return next;
+    }
+
+    // a double rotation would leave nL unbalanced (or a routing node with a missing
+    // child), so only rotate nL down to the left now; n is revisited afterwards
+    CNode* next = rotateLeft_nl(n, nL, nLR, hLL0, height(nLR->right.load()), nLR->left.load(), hLRL);
+    nLR->unlock();
+    nL->unlock();
+    return next;
+}
+
+/**
+* Mirror image of rebalanceToRight_nl.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::rebalanceToLeft_nl(
+        CNode* nParent, CNode* n, CNode* nR, int hL0)
+{
+    nR->lock();
+    int hR = nR->height.load();
+    if (hL0 - hR >= -1) {
+        nR->unlock();
+        return n;
+    }
+
+    CNode* nRL = nR->left.load();
+    int hRL0 = height(nRL);
+    int hRR0 = height(nR->right.load());
+    if (hRR0 >= hRL0) { //zig zig
+        CNode* next = rotateLeft_nl(nParent, n, nR, hL0, hRR0, nRL, hRL0);
+        nR->unlock();
+        return next;
+    }
+
+    nRL->lock();
+    int hRL = nRL->height.load();
+    if (hRR0 >= hRL) {
+        CNode* next = rotateLeft_nl(nParent, n, nR, hL0, hRR0, nRL, hRL);
+        nRL->unlock();
+        nR->unlock();
+        return next;
+    }
+    int hRLR = height(nRL->right.load());
+    int b = hRR0 - hRLR;
+    if (b >= -1 && b <= 1 && !((hRR0 == 0 || hRLR == 0) && nR->value.load() == NULL)) { //zig zag
+        CNode* next = rotateLeftOverRight_nl(nParent, n, nR, hL0, hRR0, nRL, hRLR);
+        nRL->unlock();
+        nR->unlock();
+        return next;
+    }
+
+    CNode* next = rotateRight_nl(n, nR, nRL, hRR0, height(nRL->left.load()), nRL->right.load(), hRLR);
+    nRL->unlock();
+    nR->unlock();
+    return next;
+}
+
+/**
+* Rotates n down and to the right. n's key range shrinks, so its version is marked as
+* shrinking for the duration and bumped afterwards. Returns the deepest node that still
+* needs work, or continues with nParent's height while its lock is held.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::rotateRight_nl(
+        CNode* nParent, CNode* n, CNode* nL, int hR, int hLL, CNode* nLR, int hLR)
+{
+    uint64_t nodeOVL = n->version.load();
+    CNode* nPL = nParent->left.load();
+    n->version.store(nodeOVL | SHRINKING);
+
+    n->left.store(nLR);
+    if (nLR != NULL) {
+        nLR->parent.store(n);
+    }
+    nL->right.store(n);
+    n->parent.store(nL);
+    if (nPL == n) {
+        nParent->left.store(nL);
+    }
+    else {
+        nParent->right.store(nL);
+    }
+    nL->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hLR, hR);
+    n->height.store(hNRepl);
+    nL->height.store(1 + std::max(hLL, hNRepl));
+    n->version.store(nodeOVL + SHRINK_COUNT_INCR);
+
+    int balN = hLR - hR;
+    if (balN < -1 || balN > 1) {
+        return n;
+    }
+    if ((nLR == NULL || hR == 0) && n->value.load() == NULL) {
+        return n;
+    }
+    int balL = hLL - hNRepl;
+    if (balL < -1 || balL > 1) {
+        return nL;
+    }
+    if (hLL == 0 && nL->value.load() == NULL) {
+        return nL;
+    }
+    return fixHeight_nl(nParent);
+}
+
+/**
+* Rotates n down and to the left.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::rotateLeft_nl(
+        CNode* nParent, CNode* n, CNode* nR, int hL, int hRR, CNode* nRL, int hRL)
+{
+    uint64_t nodeOVL = n->version.load();
+    CNode* nPL = nParent->left.load();
+    n->version.store(nodeOVL | SHRINKING);
+
+    n->right.store(nRL);
+    if (nRL != NULL) {
+        nRL->parent.store(n);
+    }
+    nR->left.store(n);
+    n->parent.store(nR);
+    if (nPL == n) {
+        nParent->left.store(nR);
+    }
+    else {
+        nParent->right.store(nR);
+    }
+    nR->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hL, hRL);
+    n->height.store(hNRepl);
+    nR->height.store(1 + std::max(hNRepl, hRR));
+    n->version.store(nodeOVL + SHRINK_COUNT_INCR);
+
+    int balN = hRL - hL;
+    if (balN < -1 || balN > 1) {
+        return n;
+    }
+    if ((nRL == NULL || hL == 0) && n->value.load() == NULL) {
+        return n;
+    }
+    int balR = hRR - hNRepl;
+    if (balR < -1 || balR > 1) {
+        return nR;
+    }
+    if (hRR == 0 && nR->value.load() == NULL) {
+        return nR;
+    }
+    return fixHeight_nl(nParent);
+}
+
+/**
+* Double rotation: nL down to the left, then n down to the right, leaving nLR on top.
+* Both n and nL lose part of their key range.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::rotateRightOverLeft_nl(
+        CNode* nParent, CNode* n, CNode* nL, int hR, int hLL, CNode* nLR, int hLRL)
+{
+    uint64_t nodeOVL = n->version.load();
+    uint64_t leftOVL = nL->version.load();
+    CNode* nPL = nParent->left.load();
+    CNode* nLRL = nLR->left.load();
+    CNode* nLRR = nLR->right.load();
+    int hLRR = height(nLRR);
+
+    n->version.store(nodeOVL | SHRINKING);
+    nL->version.store(leftOVL | SHRINKING);
+
+    n->left.store(nLRR);
+    if (nLRR != NULL) {
+        nLRR->parent.store(n);
+    }
+    nL->right.store(nLRL);
+    if (nLRL != NULL) {
+        nLRL->parent.store(nL);
+    }
+    nLR->left.store(nL);
+    nL->parent.store(nLR);
+    nLR->right.store(n);
+    n->parent.store(nLR);
+    if (nPL == n) {
+        nParent->left.store(nLR);
+    }
+    else {
+        nParent->right.store(nLR);
+    }
+    nLR->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hLRR, hR);
+    n->height.store(hNRepl);
+    int hLRepl = 1 + std::max(hLL, hLRL);
+    nL->height.store(hLRepl);
+    nLR->height.store(1 + std::max(hLRepl, hNRepl));
+
+    n->version.store(nodeOVL + SHRINK_COUNT_INCR);
+    nL->version.store(leftOVL + SHRINK_COUNT_INCR);
+
+    int balN = hLRR - hR;
+    if (balN < -1 || balN > 1) {
+        return n;
+    }
+    if ((nLRR == NULL || hR == 0) && n->value.load() == NULL) {
+        return n;
+    }
+    int balLR = hLRepl - hNRepl;
+    if (balLR < -1 || balLR > 1) {
+        return nLR;
+    }
+    return fixHeight_nl(nParent);
+}
+
+/**
+* Double rotation: nR down to the right, then n down to the left, leaving nRL on top.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::CNode* ConcurrentAVLTree<Key, Value>::rotateLeftOverRight_nl(
+        CNode* nParent, CNode* n, CNode* nR, int hL, int hRR, CNode* nRL, int hRLR)
+{
+    uint64_t nodeOVL = n->version.load();
+    uint64_t rightOVL = nR->version.load();
+    CNode* nPL = nParent->left.load();
+    CNode* nRLL = nRL->left.load();
+    CNode* nRLR = nRL->right.load();
+    int hRLL = height(nRLL);
+
+    n->version.store(nodeOVL | SHRINKING);
+    nR->version.store(rightOVL | SHRINKING);
+
+    n->right.store(nRLL);
+    if (nRLL != NULL) {
+        nRLL->parent.store(n);
+    }
+    nR->left.store(nRLR);
+    if (nRLR != NULL) {
+        nRLR->parent.store(nR);
+    }
+    nRL->right.store(nR);
+    nR->parent.store(nRL);
+    nRL->left.store(n);
+    n->parent.store(nRL);
+    if (nPL == n) {
+        nParent->left.store(nRL);
+    }
+    else {
+        nParent->right.store(nRL);
+    }
+    nRL->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hL, hRLL);
+    n->height.store(hNRepl);
+    int hRRepl = 1 + std::max(hRLR, hRR);
+    nR->height.store(hRRepl);
+    nRL->height.store(1 + std::max(hNRepl, hRRepl));
+
+    n->version.store(nodeOVL + SHRINK_COUNT_INCR);
+    nR->version.store(rightOVL + SHRINK_COUNT_INCR);
+
+    int balN = hRLL - hL;
+    if (balN < -1 || balN > 1) {
+        return n;
+    }
+    if ((nRLL == NULL || hL == 0) && n->value.load() == NULL) {
+        return n;
+    }
+    int balRL = hRRepl - hNRepl;
+    if (balRL < -1 || balRL > 1) {
+        return nRL;
+    }
+    return fixHeight_nl(nParent);
+}
+
+/*
+----------------------------------------------------
+End implementations for the ConcurrentAVLTree class.
+----------------------------------------------------
+*/
+
+#endif
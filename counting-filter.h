@@ -0,0 +1,111 @@
+#ifndef COUNTING_FILTER_H
+#define COUNTING_FILTER_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+* A blocked counting Bloom filter over 64-bit hashes. Each hash selects one 64-byte
+* block and sets PROBES counters inside it, so a query costs one cache miss however
+* many probes it makes. Counters (rather than bits) let remove() undo add(). A counter
+* that reaches 255 sticks there, which can only cause false positives, never false
+* negatives.
+*
+* With about 10 counters per item the false positive rate is around 2%. Items beyond
+* capacity() still work but raise the rate; rebuild with a larger capacity instead.
+*/
+class CountingBloomFilter
+{
+public:
+    static const size_t BLOCK_COUNTERS = 64;
+    static const size_t PROBES = 6;
+    static const size_t ITEMS_PER_BLOCK = 6;
+
+    explicit CountingBloomFilter(size_t capacity = 0);
+
+    size_t capacity() const { return mBlocks.size() * ITEMS_PER_BLOCK; }
+    void swap(CountingBloomFilter& other) { mBlocks.swap(other.mBlocks); }
+    void add(uint64_t hash);
+    void remove(uint64_t hash);
+    // False means hash was definitely never added (or has been removed).
+    bool mayContain(uint64_t hash) const;
+
+private:
+    struct alignas(64) Block
+    {
+        uint8_t counters[BLOCK_COUNTERS];
+    };
+
+    Block& blockFor(uint64_t hash) { return mBlocks[((hash >> 32) * mBlocks.size()) >> 32]; }
+    const Block& blockFor(uint64_t hash) const { return mBlocks[((hash >> 32) * mBlocks.size()) >> 32]; }
+    // The counter index of probe i: six bits of the hash's low half.
+    static size_t probe(uint64_t hash, size_t i) { return (hash >> (6 * i)) & (BLOCK_COUNTERS - 1); }
+
+    std::vector<Block> mBlocks;
+};
+
+/*
+-------------------------------------------------------
+Begin implementations for the CountingBloomFilter class.
+-------------------------------------------------------
+*/
+
+/**
+* Constructor. Every counter starts at zero.
+*/
+inline CountingBloomFilter::CountingBloomFilter(size_t capacity)
+    : mBlocks((capacity + ITEMS_PER_BLOCK - 1) / ITEMS_PER_BLOCK + 1, Block())
+{
+
+}
+
+/**
+* Increments the item's counters. Two probes landing on the same counter count twice,
+* and remove() decrements it twice, so they stay balanced.
+*/
+inline void CountingBloomFilter::add(uint64_t hash)
+{
+    Block& block = blockFor(hash);
+    for (size_t i = 0; i < PROBES; ++i) {
+        uint8_t& counter = block.counters[probe(hash, i)];
+        if (counter != 255) {
+            ++counter;
+        }
+    }
+}
+
+/**
+* Decrements the item's counters. hash must have been added.
+*/
+inline void CountingBloomFilter::remove(uint64_t hash)
+{
+    Block& block = blockFor(hash);
+    for (size_t i = 0; i < PROBES; ++i) {
+        uint8_t& counter = block.counters[probe(hash, i)];
+        if (counter != 255 && counter != 0) {
+            --counter;
+        }
+    }
+}
+
+/**
+* True if every probed counter is nonzero.
+*/
+inline bool CountingBloomFilter::mayContain(uint64_t hash) const
+{
+    const Block& block = blockFor(hash);
+    for (size_t i = 0; i < PROBES; ++i) {
+        if (block.counters[probe(hash, i)] == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+-----------------------------------------------------
+End implementations for the CountingBloomFilter class.
+-----------------------------------------------------
+*/
+
+#endif
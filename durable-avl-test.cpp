@@ -0,0 +1,127 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "durable-avl.h"
+
+using namespace std;
+
+const string kPath = "/tmp/durable-avl-test";
+const string kCrashPath = "/tmp/durable-avl-test-crash";
+
+void removeFiles(const string& path)
+{
+    ::unlink((path + ".wal").c_str());
+    ::unlink((path + ".ckpt").c_str());
+}
+
+// Copies what is on disk right now, as if the process had died at this point.
+void crashImage(const string& from, const string& to)
+{
+    removeFiles(to);
+    const char* suffixes[] = {".wal", ".ckpt"};
+    for (int i = 0; i < 2; ++i) {
+        ifstream in((from + suffixes[i]).c_str(), ios::binary);
+        if (in) {
+            ofstream out((to + suffixes[i]).c_str(), ios::binary);
+            out << in.rdbuf();
+        }
+    }
+}
+
+string contents(AVLTree<int, string>& tree)
+{
+    string result;
+    for (AVLTree<int, string>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        result += to_string(it->first) + "=" + it->second + " ";
+    }
+    return result;
+}
+
+void test1(const char* msg)
+{
+    removeFiles(kPath);
+    string expected;
+    {
+        DurableAVLTree<int, string> tree(kPath);
+        for (int i = 0; i < 10; ++i) {
+            tree.insert(make_pair(i, string(i, 'x')));
+        }
+        tree.erase(3);
+        tree.insert(make_pair(5, string("five")));
+        expected = contents(tree);
+    }
+    DurableAVLTree<int, string> reopened(kPath);
+    cout << msg << ": " << (contents(reopened) == expected) << endl;
+}
+
+void test2(const char* msg)
+{
+    removeFiles(kPath);
+    WalOptions options;
+    options.groupCommitRecords = 4;
+    options.checkpointRecords = 50;
+    string expected;
+    {
+        DurableAVLTree<int, string> tree(kPath, options);
+        for (int i = 0; i < 120; ++i) {
+            tree.insert(make_pair(i % 37, to_string(i)));
+            if (i % 7 == 0) {
+                tree.erase(i % 11);
+            }
+        }
+        expected = contents(tree);
+    }
+    DurableAVLTree<int, string> reopened(kPath, options);
+    cout << msg << ": " << (contents(reopened) == expected) << endl;
+}
+
+void test3(const char* msg)
+{
+    removeFiles(kPath);
+    WalOptions options;
+    options.groupCommitRecords = 1000;
+    DurableAVLTree<int, string> tree(kPath, options);
+    tree.insert(make_pair(1, string("one")));
+    tree.insert(make_pair(2, string("two")));
+    tree.commit();
+    string expected = contents(tree);
+    tree.insert(make_pair(3, string("uncommitted")));
+    crashImage(kPath, kCrashPath);
+
+    // a torn record at the end of the log must be ignored
+    ofstream log((kCrashPath + ".wal").c_str(), ios::binary | ios::app);
+    log << "\x10\x00\x00\x00garbage";
+    log.close();
+
+    DurableAVLTree<int, string> recovered(kCrashPath, options);
+    cout << msg << ": " << (contents(recovered) == expected) << endl;
+}
+
+void test4(const char* msg)
+{
+    removeFiles(kPath);
+    string expected;
+    {
+        DurableAVLTree<int, string> tree(kPath);
+        tree.insert(make_pair(1, string("one")));
+        tree.checkpoint();
+        tree.clear();
+        tree.insert(make_pair(2, string("two")));
+        expected = contents(tree);
+    }
+    DurableAVLTree<int, string> reopened(kPath);
+    cout << msg << ": " << (contents(reopened) == expected) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+    test4("Test4");
+
+    removeFiles(kPath);
+    removeFiles(kCrashPath);
+}
@@ -0,0 +1,598 @@
+#ifndef DURABLE_AVL_H
+#define DURABLE_AVL_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "avlbst.h"
+
+/**
+* Converts keys and values to and from the byte format used by the write-ahead log and
+* checkpoints. Trivially copyable types are written as raw bytes; specialize this for any
+* other type you want to keep in a DurableAVLTree (std::string is handled below).
+*/
+template <typename T>
+struct WalCodec
+{
+    static_assert(std::is_trivially_copyable<T>::value, "WalCodec must be specialized for this type");
+
+    static void encode(const T& item, std::string& out)
+    {
+        out.append(reinterpret_cast<const char*>(&item), sizeof(T));
+    }
+
+    static bool decode(const char*& pos, const char* end, T& item)
+    {
+        if (end - pos < (std::ptrdiff_t)sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&item, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+};
+
+/**
+* Strings are stored as a 32 bit length followed by the characters.
+*/
+template <>
+struct WalCodec<std::string>
+{
+    static void encode(const std::string& item, std::string& out)
+    {
+        uint32_t len = (uint32_t)item.size();
+        WalCodec<uint32_t>::encode(len, out);
+        out.append(item);
+    }
+
+    static bool decode(const char*& pos, const char* end, std::string& item)
+    {
+        uint32_t len;
+        if (!WalCodec<uint32_t>::decode(pos, end, len) || end - pos < (std::ptrdiff_t)len) {
+            return false;
+        }
+        item.assign(pos, len);
+        pos += len;
+        return true;
+    }
+};
+
+/**
+* Tuning knobs for a DurableAVLTree.
+*/
+struct WalOptions
+{
+    // Number of records buffered in memory before they are written to the log as one group.
+    size_t groupCommitRecords = 64;
+    // Number of group writes between calls to fsync. 1 syncs every group.
+    size_t syncEveryGroups = 1;
+    // Number of logged records after which a checkpoint is taken. 0 disables checkpointing.
+    size_t checkpointRecords = 1 << 20;
+};
+
+/**
+* FNV-1a hash used to detect torn or corrupted log records and checkpoints.
+*/
+inline uint32_t walChecksum(const char* data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+* Writes all of buf to fd, retrying on short writes. Throws on failure.
+*/
+inline void walWriteAll(int fd, const char* buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("WAL write failed: ") + std::strerror(errno));
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+/**
+* Reads the whole file at path into contents. Returns false if the file does not exist.
+*/
+inline bool walReadFile(const std::string& path, std::string& contents)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return false;
+        }
+        throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+    }
+    contents.clear();
+    char buf[1 << 16];
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot read " + path + ": " + std::strerror(errno));
+        }
+        if (n == 0) {
+            break;
+        }
+        contents.append(buf, (size_t)n);
+    }
+    ::close(fd);
+    return true;
+}
+
+/**
+* Flushes the directory entry for path so that a rename into it survives a crash.
+*/
+inline void walSyncDirectory(const std::string& path)
+{
+    std::string::size_type slash = path.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+/**
+* An AVL tree whose insert/erase/clear operations are recorded in a write-ahead log.
+*
+* Records are buffered and written as a group, and fsync is issued once per
+* syncEveryGroups groups, so an operation is only guaranteed durable after commit()
+* returns (or the tree is destroyed). Every checkpointRecords records the whole tree is
+* written to "<path>.ckpt" and the log at "<path>.wal" is truncated. Constructing a tree
+* on an existing path recovers it by loading the checkpoint and replaying the log; a torn
+* record at the end of the log (from a crash mid-write) is discarded.
+*/
+template <class Key, class Value>
+class DurableAVLTree : public AVLTree<Key, Value>
+{
+public:
+    DurableAVLTree(const std::string& path, const WalOptions& options = WalOptions());
+    ~DurableAVLTree();
+
+    virtual void insert(const std::pair<Key, Value>& keyValuePair) override;
+    virtual void erase(const Key& key) override;
+    // These hide the AVLTree versions so that every removed key is logged.
+    typename AVLTree<Key, Value>::iterator erase(typename AVLTree<Key, Value>::iterator pos);
+    typename AVLTree<Key, Value>::iterator erase(typename AVLTree<Key, Value>::iterator first, typename AVLTree<Key, Value>::iterator last);
+    template <typename Pred>
+    size_t erase_if(Pred pred);
+    void clear();
+    // Hides the AVLTree version so the rebuild is logged as a clear and inserts.
+    template <typename InputIt>
+    void assignSorted(InputIt first, InputIt last);
+
+    // Writes any buffered records and forces them to stable storage.
+    void commit();
+    // Writes a full snapshot of the tree and truncates the log.
+    void checkpoint();
+
+private:
+    enum RecordType : char { RECORD_INSERT = 'I', RECORD_ERASE = 'E', RECORD_CLEAR = 'C' };
+
+    void recover();
+    void loadCheckpoint();
+    void replayLog();
+    bool applyRecord(const char* pos, const char* end);
+    void beginRecord(RecordType type);
+    void endRecord();
+    void writeGroup(bool sync);
+
+    std::string mLogPath;
+    std::string mCheckpointPath;
+    WalOptions mOptions;
+    int mLogFd;
+    std::string mBuffer;
+    size_t mBufferedRecords;
+    size_t mUnsyncedGroups;
+    size_t mLoggedRecords;
+    size_t mRecordStart;
+};
+
+/*
+---------------------------------------------------
+Begin implementations for the DurableAVLTree class.
+---------------------------------------------------
+*/
+
+/**
+* Opens (or creates) the log at path and recovers any state left by a previous run.
+*/
+template<typename Key, typename Value>
+DurableAVLTree<Key, Value>::DurableAVLTree(const std::string& path, const WalOptions& options)
+    : mLogPath(path + ".wal")
+    , mCheckpointPath(path + ".ckpt")
+    , mOptions(options)
+    , mLogFd(-1)
+    , mBufferedRecords(0)
+    , mUnsyncedGroups(0)
+    , mLoggedRecords(0)
+    , mRecordStart(0)
+{
+    if (mOptions.groupCommitRecords == 0) {
+        mOptions.groupCommitRecords = 1;
+    }
+    recover();
+}
+
+/**
+* Commits outstanding records before closing the log. The in-memory nodes are freed by
+* the BinarySearchTree destructor.
+*/
+template<typename Key, typename Value>
+DurableAVLTree<Key, Value>::~DurableAVLTree()
+{
+    try {
+        commit();
+    }
+    catch (const std::exception&) {
+        // nothing sensible to do from a destructor; recovery will replay what made it to disk
+    }
+    ::close(mLogFd);
+}
+
+/**
+* Applies and logs an insert. The tree is updated first so that a checkpoint triggered by
+* this record already contains it.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    AVLTree<Key, Value>::insert(keyValuePair);
+    beginRecord(RECORD_INSERT);
+    WalCodec<Key>::encode(keyValuePair.first, mBuffer);
+    WalCodec<Value>::encode(keyValuePair.second, mBuffer);
+    endRecord();
+}
+
+/**
+* Applies and logs an erase.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::erase(const Key& key)
+{
+    AVLTree<Key, Value>::erase(key);
+    beginRecord(RECORD_ERASE);
+    WalCodec<Key>::encode(key, mBuffer);
+    endRecord();
+}
+
+/**
+* Applies and logs an erase by position.
+*/
+template<typename Key, typename Value>
+typename AVLTree<Key, Value>::iterator DurableAVLTree<Key, Value>::erase(typename AVLTree<Key, Value>::iterator pos)
+{
+    if (pos == this->end()) {
+        return pos;
+    }
+    Key key = pos->first;
+    typename AVLTree<Key, Value>::iterator next = AVLTree<Key, Value>::erase(pos);
+    beginRecord(RECORD_ERASE);
+    WalCodec<Key>::encode(key, mBuffer);
+    endRecord();
+    return next;
+}
+
+/**
+* Applies a range erase and logs one erase per removed key.
+*/
+template<typename Key, typename Value>
+typename AVLTree<Key, Value>::iterator DurableAVLTree<Key, Value>::erase(typename AVLTree<Key, Value>::iterator first, typename AVLTree<Key, Value>::iterator last)
+{
+    std::vector<Key> keys;
+    for (typename AVLTree<Key, Value>::iterator it = first; it != last; ++it) {
+        keys.push_back(it->first);
+    }
+    AVLTree<Key, Value>::erase(first, last);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        beginRecord(RECORD_ERASE);
+        WalCodec<Key>::encode(keys[i], mBuffer);
+        endRecord();
+    }
+    return last;
+}
+
+/**
+* Applies a conditional erase and logs one erase per removed key.
+*/
+template<typename Key, typename Value>
+template<typename Pred>
+size_t DurableAVLTree<Key, Value>::erase_if(Pred pred)
+{
+    std::vector<Key> keys;
+    size_t removed = AVLTree<Key, Value>::erase_if([&pred, &keys](const std::pair<Key, Value>& item) {
+        if (pred(item)) {
+            keys.push_back(item.first);
+            return true;
+        }
+        return false;
+    });
+    for (size_t i = 0; i < keys.size(); ++i) {
+        beginRecord(RECORD_ERASE);
+        WalCodec<Key>::encode(keys[i], mBuffer);
+        endRecord();
+    }
+    return removed;
+}
+
+/**
+* Applies and logs a clear.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::clear()
+{
+    AVLTree<Key, Value>::clear();
+    beginRecord(RECORD_CLEAR);
+    endRecord();
+}
+
+/**
+* Applies a bulk build and logs it. The range is read twice, so it must be a forward
+* range.
+*/
+template<typename Key, typename Value>
+template<typename InputIt>
+void DurableAVLTree<Key, Value>::assignSorted(InputIt first, InputIt last)
+{
+    AVLTree<Key, Value>::assignSorted(first, last);
+    beginRecord(RECORD_CLEAR);
+    endRecord();
+    for (; first != last; ++first) {
+        beginRecord(RECORD_INSERT);
+        WalCodec<Key>::encode(first->first, mBuffer);
+        WalCodec<Value>::encode(first->second, mBuffer);
+        endRecord();
+    }
+}
+
+/**
+* Writes the buffered group (if any) and fsyncs the log.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::commit()
+{
+    writeGroup(true);
+}
+
+/**
+* Writes every item to a temporary file, atomically renames it over the previous
+* checkpoint and then truncates the log. If we crash after the rename but before the
+* truncate, recovery replays the old log on top of the new checkpoint, which is harmless
+* because every record is a blind overwrite of its key.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::checkpoint()
+{
+    writeGroup(false);
+
+    std::string snapshot("AVLCKPT1", 8);
+    uint64_t count = 0;
+    WalCodec<uint64_t>::encode(count, snapshot);
+    for (typename AVLTree<Key, Value>::iterator it = this->begin(); it != this->end(); ++it) {
+        WalCodec<Key>::encode(it->first, snapshot);
+        WalCodec<Value>::encode(it->second, snapshot);
+        ++count;
+    }
+    std::memcpy(&snapshot[8], &count, sizeof(count));
+    uint32_t sum = walChecksum(snapshot.data(), snapshot.size());
+    WalCodec<uint32_t>::encode(sum, snapshot);
+
+    std::string tmpPath = mCheckpointPath + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("cannot create " + tmpPath + ": " + std::strerror(errno));
+    }
+    walWriteAll(fd, snapshot.data(), snapshot.size());
+    if (::fsync(fd) != 0 || ::close(fd) != 0) {
+        throw std::runtime_error("cannot sync " + tmpPath + ": " + std::strerror(errno));
+    }
+    if (::rename(tmpPath.c_str(), mCheckpointPath.c_str()) != 0) {
+        throw std::runtime_error("cannot install " + mCheckpointPath + ": " + std::strerror(errno));
+    }
+    walSyncDirectory(mCheckpointPath);
+
+    if (::ftruncate(mLogFd, 0) != 0 || ::fsync(mLogFd) != 0) {
+        throw std::runtime_error("cannot truncate " + mLogPath + ": " + std::strerror(errno));
+    }
+    mUnsyncedGroups = 0;
+    mLoggedRecords = 0;
+}
+
+/**
+* Rebuilds the tree from the checkpoint and log, then opens the log for appending.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::recover()
+{
+    loadCheckpoint();
+    replayLog();
+    mLogFd = ::open(mLogPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (mLogFd < 0) {
+        throw std::runtime_error("cannot open " + mLogPath + ": " + std::strerror(errno));
+    }
+}
+
+/**
+* Loads the last checkpoint, if there is one. A checkpoint only becomes visible through
+* an atomic rename, so a bad checksum here means real corruption rather than a crash.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::loadCheckpoint()
+{
+    std::string contents;
+    if (!walReadFile(mCheckpointPath, contents)) {
+        return;
+    }
+
+    uint32_t sum;
+    if (contents.size() < 8 + sizeof(uint64_t) + sizeof(sum) || contents.compare(0, 8, "AVLCKPT1") != 0) {
+        throw std::runtime_error("corrupt checkpoint " + mCheckpointPath);
+    }
+    std::memcpy(&sum, contents.data() + contents.size() - sizeof(sum), sizeof(sum));
+    if (sum != walChecksum(contents.data(), contents.size() - sizeof(sum))) {
+        throw std::runtime_error("corrupt checkpoint " + mCheckpointPath);
+    }
+
+    const char* pos = contents.data() + 8;
+    const char* end = contents.data() + contents.size() - sizeof(sum);
+    uint64_t count = 0;
+    WalCodec<uint64_t>::decode(pos, end, count);
+    for (uint64_t i = 0; i < count; ++i) {
+        std::pair<Key, Value> item;
+        if (!WalCodec<Key>::decode(pos, end, item.first) || !WalCodec<Value>::decode(pos, end, item.second)) {
+            throw std::runtime_error("corrupt checkpoint " + mCheckpointPath);
+        }
+        AVLTree<Key, Value>::insert(item);
+    }
+}
+
+/**
+* Replays every complete record in the log. Each record is laid out as
+* [uint32 payload length][uint32 checksum][payload], so the first record that is short
+* or fails its checksum marks the end of what was durably written; it and anything after
+* it are cut off.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::replayLog()
+{
+    std::string contents;
+    if (!walReadFile(mLogPath, contents)) {
+        return;
+    }
+
+    const char* pos = contents.data();
+    const char* end = pos + contents.size();
+    while (pos < end) {
+        const char* next = pos;
+        uint32_t len, sum;
+        if (!WalCodec<uint32_t>::decode(next, end, len) || !WalCodec<uint32_t>::decode(next, end, sum)
+            || end - next < (std::ptrdiff_t)len || walChecksum(next, len) != sum
+            || !applyRecord(next, next + len)) {
+            break;
+        }
+        pos = next + len;
+        ++mLoggedRecords;
+    }
+
+    if (pos != end) {
+        if (::truncate(mLogPath.c_str(), (off_t)(pos - contents.data())) != 0) {
+            throw std::runtime_error("cannot truncate " + mLogPath + ": " + std::strerror(errno));
+        }
+    }
+}
+
+/**
+* Applies one log payload to the tree without logging it again.
+*/
+template<typename Key, typename Value>
+bool DurableAVLTree<Key, Value>::applyRecord(const char* pos, const char* end)
+{
+    if (pos == end) {
+        return false;
+    }
+    char type = *pos++;
+    std::pair<Key, Value> item;
+    switch (type) {
+    case RECORD_INSERT:
+        if (!WalCodec<Key>::decode(pos, end, item.first) || !WalCodec<Value>::decode(pos, end, item.second)) {
+            return false;
+        }
+        AVLTree<Key, Value>::insert(item);
+        return true;
+    case RECORD_ERASE:
+        if (!WalCodec<Key>::decode(pos, end, item.first)) {
+            return false;
+        }
+        AVLTree<Key, Value>::erase(item.first);
+        return true;
+    case RECORD_CLEAR:
+        AVLTree<Key, Value>::clear();
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+* Reserves space for the record header and writes the record type.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::beginRecord(RecordType type)
+{
+    mRecordStart = mBuffer.size();
+    mBuffer.append(2 * sizeof(uint32_t), '\0');
+    mBuffer.push_back((char)type);
+}
+
+/**
+* Fills in the record header and hands full groups to the log.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::endRecord()
+{
+    const size_t payload = mRecordStart + 2 * sizeof(uint32_t);
+    uint32_t len = (uint32_t)(mBuffer.size() - payload);
+    uint32_t sum = walChecksum(mBuffer.data() + payload, len);
+    std::memcpy(&mBuffer[mRecordStart], &len, sizeof(len));
+    std::memcpy(&mBuffer[mRecordStart + sizeof(len)], &sum, sizeof(sum));
+
+    ++mLoggedRecords;
+    if (++mBufferedRecords >= mOptions.groupCommitRecords) {
+        writeGroup(false);
+    }
+    if (mOptions.checkpointRecords != 0 && mLoggedRecords >= mOptions.checkpointRecords) {
+        checkpoint();
+    }
+}
+
+/**
+* Writes the buffered records with a single write() call. The log is fsynced when sync
+* is set or once syncEveryGroups groups have been written since the last fsync.
+*/
+template<typename Key, typename Value>
+void DurableAVLTree<Key, Value>::writeGroup(bool sync)
+{
+    if (!mBuffer.empty()) {
+        walWriteAll(mLogFd, mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+        mBufferedRecords = 0;
+        ++mUnsyncedGroups;
+    }
+    if (mUnsyncedGroups > 0 && (sync || mUnsyncedGroups >= mOptions.syncEveryGroups)) {
+        if (::fdatasync(mLogFd) != 0) {
+            throw std::runtime_error("cannot sync " + mLogPath + ": " + std::strerror(errno));
+        }
+        mUnsyncedGroups = 0;
+    }
+}
+
+/*
+-------------------------------------------------
+End implementations for the DurableAVLTree class.
+-------------------------------------------------
+*/
+
+#endif
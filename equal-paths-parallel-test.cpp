@@ -0,0 +1,120 @@
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include "equal-paths.h"
+#include "equal-paths-parallel.h"
+using namespace std;
+
+
+// Builds a perfect tree of the given depth in nodes, returning the root.
+Node* buildPerfect(vector<Node*>& nodes, int depth)
+{
+  int count = (1 << (depth + 1)) - 1;
+  for (int i = 0; i < count; i++)
+  {
+    nodes.push_back(new Node(i));
+  }
+  for (int i = 0; 2*i + 2 < count; i++)
+  {
+    nodes[i]->left = nodes[2*i+1];
+    nodes[i]->right = nodes[2*i+2];
+  }
+  return nodes[0];
+}
+
+void deleteAll(vector<Node*>& nodes)
+{
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    delete nodes[i];
+  }
+  nodes.clear();
+}
+
+void test1(const char* msg)
+{
+  vector<Node*> nodes;
+  Node* root = buildPerfect(nodes, 18);
+  bool ok = equalPathsParallel(root, 4);
+  // one extra node deep in the last subtree
+  Node* extra = new Node(-1);
+  nodes.back()->right = extra;
+  ok = ok && !equalPathsParallel(root, 4);
+  delete extra;
+  cout << msg << ": " <<   ok << endl;
+  deleteAll(nodes);
+}
+
+void test2(const char* msg)
+{
+  // random shapes must agree with the sequential version
+  srand(35);
+  bool ok = true;
+  for (int t = 0; t < 200 && ok; t++)
+  {
+    vector<Node*> nodes;
+    buildPerfect(nodes, 6);
+    for (size_t i = 1; i < nodes.size(); i++)
+    {
+      if (rand() % 40 == 0)
+      {
+        // cut off a subtree
+        size_t parent = (i - 1) / 2;
+        if (nodes[parent]->left == nodes[i]) nodes[parent]->left = nullptr;
+        if (nodes[parent]->right == nodes[i]) nodes[parent]->right = nullptr;
+      }
+    }
+    ok = (equalPathsParallel(nodes[0], 3) == equalPaths(nodes[0]));
+    deleteAll(nodes);
+  }
+  cout << msg << ": " <<   ok << endl;
+}
+
+void test3(const char* msg)
+{
+  vector<Node*> nodes;
+  vector<Node*> roots;
+  vector<bool> expected;
+  for (int t = 0; t < 50; t++)
+  {
+    vector<Node*> tree;
+    roots.push_back(buildPerfect(tree, t % 8));
+    if (t % 3 == 0 && tree.size() > 1)
+    {
+      tree[0]->left = nullptr; //leaves now differ by one level, except under a single child
+    }
+    expected.push_back(equalPaths(roots.back()));
+    nodes.insert(nodes.end(), tree.begin(), tree.end());
+  }
+  roots.push_back(nullptr);
+  expected.push_back(true);
+  cout << msg << ": " <<   (equalPathsBatch(roots, 4) == expected) << endl;
+  deleteAll(nodes);
+}
+
+void test4(const char* msg)
+{
+  // degenerate chains never widen, so they fall back to the sequential walk
+  vector<Node*> nodes;
+  for (int i = 0; i < 100000; i++)
+  {
+    nodes.push_back(new Node(i));
+    if (i > 0) nodes[i-1]->right = nodes[i];
+  }
+  bool ok = equalPathsParallel(nodes[0], 4);
+  // a second leaf one level above the bottom
+  Node* extra = new Node(-1);
+  nodes[nodes.size() - 3]->left = extra;
+  nodes.push_back(extra);
+  ok = ok && !equalPathsParallel(nodes[0], 4);
+  cout << msg << ": " <<   ok << endl;
+  deleteAll(nodes);
+}
+
+int main()
+{
+  test1("Test1");
+  test2("Test2");
+  test3("Test3");
+  test4("Test4");
+}
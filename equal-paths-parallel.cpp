@@ -0,0 +1,208 @@
+#include "equal-paths-parallel.h"
+#include <atomic>
+#include <thread>
+#include <utility>
+using namespace std;
+
+
+// State shared by every worker checking one tree.
+struct LeafDepthCheck
+{
+    atomic<long> reference; //depth of the first leaf any worker found, or -1
+    atomic<bool> cancelled; //set as soon as any worker finds a mismatch
+
+    LeafDepthCheck() : reference(-1), cancelled(false) {}
+
+    // Records the depth of a leaf. Returns false if it disagrees with the first leaf.
+    bool leaf(size_t depth)
+    {
+        long expected = -1;
+        if (reference.compare_exchange_strong(expected, (long)depth))
+        {
+            return true; //this is the first leaf; it defines the depth
+        }
+        return expected == (long)depth;
+    }
+
+    // True if an internal node at depth can only lead to leaves deeper than the first.
+    bool tooDeep(size_t depth) const
+    {
+        long r = reference.load(memory_order_relaxed);
+        return r >= 0 && (long)depth >= r;
+    }
+
+    void fail()
+    {
+        cancelled.store(true, memory_order_relaxed);
+    }
+};
+
+size_t workerCount(size_t threads); //prototypes
+void checkSubtree(Node* root, size_t depth, LeafDepthCheck& check);
+template <typename Fn>
+void runWorkers(size_t threads, size_t tasks, Fn fn);
+
+size_t workerCount(size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = thread::hardware_concurrency();
+    }
+    return (threads == 0) ? 1 : threads;
+}
+
+// Same walk as equalPaths, against the shared depth. Polls the cancellation flag every
+// 256 nodes so a mismatch found elsewhere stops this worker quickly.
+void checkSubtree(Node* root, size_t depth, LeafDepthCheck& check)
+{
+    vector<pair<Node*, size_t> > stack;
+    stack.push_back(make_pair(root, depth));
+    size_t visited = 0;
+
+    while (!stack.empty())
+    {
+        if ((++visited & 255) == 0 && check.cancelled.load(memory_order_relaxed))
+        {
+            return;
+        }
+        Node* node = stack.back().first;
+        size_t d = stack.back().second;
+        stack.pop_back();
+
+        if (node->left == nullptr && node->right == nullptr)
+        {
+            if (!check.leaf(d))
+            {
+                check.fail();
+                return;
+            }
+            continue;
+        }
+        if (check.tooDeep(d))
+        {
+            check.fail();
+            return;
+        }
+        if (node->right)
+        {
+            stack.push_back(make_pair(node->right, d + 1));
+        }
+        if (node->left)
+        {
+            stack.push_back(make_pair(node->left, d + 1));
+        }
+    }
+}
+
+// Runs fn(i) for every i in [0, tasks) on up to threads threads. Tasks are handed out
+// one at a time from a shared counter, so uneven tasks still balance.
+template <typename Fn>
+void runWorkers(size_t threads, size_t tasks, Fn fn)
+{
+    atomic<size_t> next(0);
+    auto work = [&next, tasks, &fn] {
+        for (size_t i = next.fetch_add(1); i < tasks; i = next.fetch_add(1))
+        {
+            fn(i);
+        }
+    };
+    if (threads > tasks)
+    {
+        threads = tasks;
+    }
+    vector<thread> workers;
+    for (size_t i = 1; i < threads; i++)
+    {
+        workers.push_back(thread(work));
+    }
+    work(); //the calling thread is a worker too
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+bool equalPathsParallel(Node * root, size_t threads)
+{
+    threads = workerCount(threads);
+    if (root == nullptr)
+    {
+        return true;
+    }
+    if (threads == 1)
+    {
+        return equalPaths(root);
+    }
+
+    // Expand the top of the tree level by level until there are about eight subtrees
+    // per worker. Leaves met on the way are checked here, before any worker starts.
+    // A balanced tree gets there in log2(threads * 8) levels; one that still has fewer
+    // subtrees than workers a few levels later (a degenerate chain never widens) would
+    // be walked here one level at a time, so it is checked sequentially instead.
+    size_t levelLimit = 4;
+    for (size_t width = 1; width < threads * 8; width *= 2)
+    {
+        levelLimit++;
+    }
+    LeafDepthCheck check;
+    vector<pair<Node*, size_t> > frontier;
+    frontier.push_back(make_pair(root, (size_t)0));
+    for (size_t level = 0; frontier.size() < threads * 8; level++)
+    {
+        if (level == levelLimit)
+        {
+            if (frontier.size() < threads)
+            {
+                return equalPaths(root);
+            }
+            break;
+        }
+        vector<pair<Node*, size_t> > next;
+        bool expanded = false;
+        for (size_t i = 0; i < frontier.size(); i++)
+        {
+            Node* node = frontier[i].first;
+            size_t depth = frontier[i].second;
+            if (node->left == nullptr && node->right == nullptr)
+            {
+                if (!check.leaf(depth))
+                {
+                    return false;
+                }
+                continue;
+            }
+            expanded = true;
+            if (node->left)
+            {
+                next.push_back(make_pair(node->left, depth + 1));
+            }
+            if (node->right)
+            {
+                next.push_back(make_pair(node->right, depth + 1));
+            }
+        }
+        frontier.swap(next);
+        if (!expanded)
+        {
+            break; //every remaining node was a leaf
+        }
+    }
+
+    runWorkers(threads, frontier.size(), [&frontier, &check](size_t i) {
+        if (!check.cancelled.load(memory_order_relaxed))
+        {
+            checkSubtree(frontier[i].first, frontier[i].second, check);
+        }
+    });
+    return !check.cancelled.load();
+}
+
+vector<bool> equalPathsBatch(const vector<Node*>& roots, size_t threads)
+{
+    // vector<bool> packs bits, so workers write to separate bytes and copy at the end
+    vector<char> results(roots.size(), 0);
+    runWorkers(workerCount(threads), roots.size(), [&roots, &results](size_t i) {
+        results[i] = equalPaths(roots[i]);
+    });
+    return vector<bool>(results.begin(), results.end());
+}
@@ -0,0 +1,31 @@
+#ifndef EQUAL_PATHS_PARALLEL_H
+#define EQUAL_PATHS_PARALLEL_H
+#include <cstddef>
+#include <vector>
+#include "equal-paths.h"
+
+/**
+ * @brief Parallel version of equalPaths for very large trees.
+ *
+ *        The top of the tree is split into independent subtrees that worker threads
+ *        check concurrently against one shared leaf depth. The first worker to find a
+ *        mismatched leaf raises a shared cancellation flag and every other worker stops
+ *        within a few hundred nodes. A tree too narrow at the top to give every worker
+ *        a subtree within a few levels (such as a degenerate chain) is checked with the
+ *        sequential equalPaths instead, which avoids the thread overhead.
+ *
+ * @param root Pointer to the root of the tree to check for equal paths
+ * @param threads Number of worker threads; 0 means one per hardware thread
+ */
+bool equalPathsParallel(Node * root, size_t threads = 0);
+
+/**
+ * @brief Runs equalPaths on many independent trees, spread across worker threads.
+ *
+ * @param roots The roots of the trees to check
+ * @param threads Number of worker threads; 0 means one per hardware thread
+ * @return results[i] is equalPaths(roots[i])
+ */
+std::vector<bool> equalPathsBatch(const std::vector<Node*>& roots, size_t threads = 0);
+
+#endif
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cstdlib>
+#include <vector>
 #include "equal-paths.h"
 using namespace std;
 
@@ -55,6 +56,50 @@ void test5(const char* msg)
   cout << msg << ": " <<   equalPaths(a) << endl;
 }
 
+void test6(const char* msg)
+{
+  // a chain far deeper than the call stack could recurse
+  const int n = 1000000;
+  vector<Node*> chain;
+  for (int i = 0; i < n; i++)
+  {
+    chain.push_back(new Node(i));
+  }
+  for (int i = 0; i + 1 < n; i++)
+  {
+    if (i % 2 == 0) chain[i]->left = chain[i+1];
+    else chain[i]->right = chain[i+1];
+  }
+  cout << msg << ": " <<   equalPaths(chain[0]) << endl;
+  for (int i = 0; i < n; i++)
+  {
+    delete chain[i];
+  }
+}
+
+void test7(const char* msg)
+{
+  // perfect tree of depth 10 with one extra node under its last leaf
+  vector<Node*> nodes;
+  for (int i = 0; i < (1 << 11) - 1; i++)
+  {
+    nodes.push_back(new Node(i));
+  }
+  for (int i = 0; 2*i + 2 < (int)nodes.size(); i++)
+  {
+    setNode(nodes[i], i, nodes[2*i+1], nodes[2*i+2]);
+  }
+  bool perfect = equalPaths(nodes[0]);
+  Node* extra = new Node(-1);
+  nodes.back()->left = extra;
+  cout << msg << ": " <<   (perfect && !equalPaths(nodes[0]) && equalPaths(NULL)) << endl;
+  delete extra;
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    delete nodes[i];
+  }
+}
+
 int main()
 {
   a = new Node(1);
@@ -67,6 +112,8 @@ int main()
   test3("Test3");
   test4("Test4");
   test5("Test5");
+  test6("Test6");
+  test7("Test7");
  
   delete a;
   delete b;
@@ -1,44 +1,59 @@
 #include "equal-paths.h"
-#include <algorithm> 
+#include <utility>
+#include <vector>
 using namespace std;
 
 
 // You may add any prototypes of helper functions here
-int pathLength(Node* node); //prototype
-
-int pathLength(Node* node)
-{
-    if(node->left == nullptr && node->right == nullptr) //if node has no children 
-    {
-        return 0; //return 0 (Halting condition)
-    }
-    else if (node->left && node->right == nullptr) //if node has just left subtree
-    {
-        return 1 + pathLength(node->left); //return 1 + recursive length of left subtree 
-    }
-    else if (node->left == nullptr && node->right) //if node has just right subtree
-    {
-        return 1 + pathLength(node->right); 
-    }
-    else if (node->left && node->right) //if node has both left and right subtrees
-    {
-        return 1 + max(pathLength(node->left), pathLength(node->right)); //returns max for true depth
-    }
-    return 0; 
-}
 
 bool equalPaths(Node * root)
 {
-    if (root->left && root->right)
+    if (root == nullptr)
     {
-        return (pathLength(root->left) == pathLength(root->right)); //call to helper, true if lengths equal 
+        return true; //an empty tree has no paths to compare
     }
-    else if (root->left == nullptr && root->right == nullptr)
-    {
-        return true; //if just 1 node return true  
-    }
-    else
+
+    // Depth-first walk with an explicit stack instead of recursion, so a degenerate
+    // chain of any length cannot overflow the call stack. Each entry is a node and its
+    // depth. Children are pushed only after their parent is popped, so the stack holds
+    // at most one pending sibling per level plus the current node.
+    vector<pair<Node*, size_t> > stack;
+    stack.push_back(make_pair(root, (size_t)0));
+    bool seenLeaf = false;
+    size_t leafDepth = 0; //depth of the first leaf found; every other leaf must match
+
+    while (!stack.empty())
     {
-        return false; //all other options reveal false 
+        Node* node = stack.back().first;
+        size_t depth = stack.back().second;
+        stack.pop_back();
+
+        if (node->left == nullptr && node->right == nullptr) //leaf
+        {
+            if (!seenLeaf)
+            {
+                seenLeaf = true;
+                leafDepth = depth;
+            }
+            else if (depth != leafDepth)
+            {
+                return false; //stop at the first mismatch
+            }
+            continue;
+        }
+
+        if (seenLeaf && depth >= leafDepth)
+        {
+            return false; //any leaf below this node would be deeper than the first leaf
+        }
+        if (node->right)
+        {
+            stack.push_back(make_pair(node->right, depth + 1));
+        }
+        if (node->left)
+        {
+            stack.push_back(make_pair(node->left, depth + 1));
+        }
     }
-}
\ No newline at end of file
+    return true;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include "durable-avl.h"
+#include "test-items.h"
+
+using namespace std;
+
+const string kPath = "/tmp/erase-test";
+
+void test1(const char* msg)
+{
+    // erase by iterator returns the next item, in both trees
+    BinarySearchTree<int, long> bst;
+    AVLTree<int, long> avl;
+    map<int, long> expected;
+    for (int i = 0; i < 200; ++i) {
+        int key = (i * 37) % 200;
+        bst.insert(make_pair(key, (long)i));
+        avl.insert(make_pair(key, (long)i));
+        expected[key] = i;
+    }
+    bool ok = true;
+    BinarySearchTree<int, long>::iterator b = bst.find(50);
+    AVLTree<int, long>::iterator a = avl.find(50);
+    while (b != bst.end() && b->first < 150) {
+        ok = ok && b->first == a->first;
+        if (b->first % 2 == 0) {
+            expected.erase(b->first);
+            b = bst.erase(b);
+            a = avl.erase(a);
+        }
+        else {
+            ++b;
+            ++a;
+        }
+    }
+    bst.remove(7);
+    avl.remove(7);
+    expected.erase(7);
+    cout << msg << ": " << (ok && treeMatches(bst, expected) && treeMatches(avl, expected)) << endl;
+}
+
+void test2(const char* msg)
+{
+    // small ranges are removed one by one, large ones by a rebuild
+    AVLTree<int, long> tree;
+    map<int, long> expected;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(make_pair(i, (long)i));
+        expected[i] = i;
+    }
+    tree.erase(tree.find(10), tree.find(20));
+    expected.erase(expected.find(10), expected.find(20));
+    bool ok = treeMatches(tree, expected);
+    tree.erase(tree.find(100), tree.find(900));
+    expected.erase(expected.find(100), expected.find(900));
+    ok = ok && treeMatches(tree, expected);
+    tree.erase(tree.begin(), tree.end());
+    cout << msg << ": " << (ok && tree.empty() && tree.mRoot == NULL) << endl;
+}
+
+void test3(const char* msg)
+{
+    // erase_if keeps summaries and pending range updates correct on both paths
+    AVLTree<int, long, RangeAddAggregate<long> > tree;
+    map<int, long> expected;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(make_pair(i, (long)i));
+        expected[i] = i;
+    }
+    tree.updateRange(0, 499, 1000);
+    for (int i = 0; i < 500; ++i) {
+        expected[i] += 1000;
+    }
+    size_t few = tree.erase_if([](const pair<int, long>& item) { return item.first % 100 == 0; });
+    size_t many = tree.erase_if([](const pair<int, long>& item) { return item.second % 3 == 0; });
+    long sum = 0;
+    for (map<int, long>::iterator it = expected.begin(); it != expected.end(); ) {
+        if (it->first % 100 == 0 || it->second % 3 == 0) {
+            it = expected.erase(it);
+        }
+        else {
+            sum += it->second;
+            ++it;
+        }
+    }
+    bool ok = few == 10 && few + many + expected.size() == 1000;
+    ok = ok && tree.aggregate(0, 999).sum == sum;
+    cout << msg << ": " << (ok && treeMatches(tree, expected)) << endl;
+}
+
+void test4(const char* msg)
+{
+    // every key removed by the new overloads is logged and stays removed after recovery
+    ::unlink((kPath + ".wal").c_str());
+    ::unlink((kPath + ".ckpt").c_str());
+    string before;
+    {
+        DurableAVLTree<int, string> tree(kPath);
+        for (int i = 0; i < 100; ++i) {
+            tree.insert(make_pair(i, to_string(i)));
+        }
+        tree.erase(tree.find(5));
+        tree.erase(tree.find(40), tree.find(60));
+        tree.erase_if([](const pair<int, string>& item) { return item.first % 7 == 0; });
+        for (AVLTree<int, string>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            before += it->second + " ";
+        }
+    }
+    DurableAVLTree<int, string> reopened(kPath);
+    string after;
+    for (AVLTree<int, string>::iterator it = reopened.begin(); it != reopened.end(); ++it) {
+        after += it->second + " ";
+    }
+    cout << msg << ": " << (before == after && reopened.size() == 100 - 1 - 20 - 12 && reopened.validate()) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+    test4("Test4");
+}
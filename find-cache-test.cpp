@@ -0,0 +1,68 @@
+#include <iostream>
+#include <string>
+#include "avlbst.h"
+#include "prefix-string.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    // hits are counted, and erased keys (including ones moved by nodeSwap) never resurface
+    AVLTree<int, int> tree;
+    tree.setFindCache(64, true);
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    bool ok = true;
+    for (int round = 0; round < 10; ++round) {
+        for (int key = 0; key < 16; ++key) {
+            ok = ok && tree.find(key)->second == key;
+        }
+    }
+    FindCacheStats stats = tree.findCacheStats();
+    ok = ok && stats.hits + stats.misses == 160 && stats.hits >= 140;
+    ok = ok && stats.hitRate() > 0.8 && stats.averageMissNanoseconds() > 0;
+
+    // the root has two children, so erasing it swaps it with its successor
+    int rootKey = tree.mRoot->getKey();
+    tree.find(rootKey);
+    tree.find(rootKey + 1);
+    tree.erase(rootKey);
+    ok = ok && tree.find(rootKey) == tree.end() && tree.find(rootKey + 1)->second == rootKey + 1;
+    tree.erase_if([](const pair<int, int>& item) { return item.first < 8; });
+    for (int key = 0; key < 16; ++key) {
+        ok = ok && (tree.find(key) == tree.end()) == (key < 8);
+    }
+    tree.clear();
+    ok = ok && tree.find(10) == tree.end();
+    tree.insert(make_pair(10, 20));
+    cout << msg << ": " << (ok && tree.find(10)->second == 20) << endl;
+}
+
+void test2(const char* msg)
+{
+    // the cache is skipped while range updates are pending, and unhashable keys disable it
+    AVLTree<int, long, RangeAddAggregate<long> > tree;
+    tree.setFindCache(16);
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, 0L));
+    }
+    tree.find(50);
+    tree.updateRange(0, 99, 3L);
+    bool ok = tree.find(50)->second == 3;
+    tree.resetFindCacheStats();
+    ok = ok && tree.findCacheStats().hits == 0;
+
+    BinarySearchTree<PrefixString, int> strings;
+    strings.setFindCache(16);
+    strings.insert(make_pair(PrefixString("key"), 1));
+    strings.find("key");
+    ok = ok && strings.find("key")->second == 1 && strings.findCacheStats().hits == 0;
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include "avlbst.h"
+
+using namespace std;
+
+// True if findMany(keys) agrees with find for every key.
+template <typename Tree>
+bool agrees(const Tree& tree, const vector<int>& keys)
+{
+    vector<typename Tree::iterator> found(3, tree.begin());
+    tree.findMany(keys, found);
+    if (found.size() != keys.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (found[i] != tree.find(keys[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Random keys in [-10, 2010), so about half hit a tree of the even keys below 2000.
+vector<int> randomKeys(mt19937& rng, size_t count)
+{
+    vector<int> keys;
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back((int)(rng() % 2020) - 10);
+    }
+    return keys;
+}
+
+bool test1(const char* msg)
+{
+    // hits and misses, in batches below, at and above the 16 lanes, and an empty batch
+    BinarySearchTree<int, int> plain;
+    AVLTree<int, int> avl;
+    mt19937 rng(27);
+    for (int i = 0; i < 1000; ++i) {
+        int key = (int)(rng() % 1000) * 2;
+        plain.insert(make_pair(key, i));
+        avl.insert(make_pair(key, i));
+    }
+    size_t sizes[] = { 0, 1, 2, 15, 16, 17, 31, 32, 33, 100, 5000 };
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        vector<int> keys = randomKeys(rng, sizes[i]);
+        ok = ok && agrees(plain, keys) && agrees(avl, keys);
+    }
+    cout << msg << ": " << ok << endl;
+    return ok;
+}
+
+bool test2(const char* msg)
+{
+    // an empty tree, repeated keys, and a degenerate chain deeper than the lanes
+    AVLTree<int, int> empty;
+    vector<int> keys;
+    for (int i = 0; i < 40; ++i) {
+        keys.push_back(i % 3);
+    }
+    bool ok = agrees(empty, keys) && agrees(empty, vector<int>());
+
+    BinarySearchTree<int, int> chain;
+    for (int i = 0; i < 500; ++i) {
+        chain.insert(make_pair(i, -i));
+    }
+    vector<int> deep;
+    for (int i = 520; i > -20; i -= 7) {
+        deep.push_back(i);
+    }
+    ok = ok && agrees(chain, deep) && agrees(chain, keys);
+    cout << msg << ": " << ok << endl;
+    return ok;
+}
+
+bool test3(const char* msg)
+{
+    // lazily erased keys are misses for findMany as for find
+    AVLTree<int, int> tree;
+    tree.setLazyErase(0.9);
+    for (int i = 0; i < 300; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    for (int i = 0; i < 300; i += 4) {
+        tree.erase(i);
+    }
+    vector<int> keys;
+    for (int i = -5; i < 305; ++i) {
+        keys.push_back(i);
+    }
+    vector<AVLTree<int, int>::iterator> found;
+    tree.findMany(keys, found);
+    bool ok = agrees(tree, keys) && found[5] == tree.end() && found[6] != tree.end();
+    cout << msg << ": " << ok << endl;
+    return ok;
+}
+
+int main()
+{
+    bool ok = test1("Test1");
+    ok = test2("Test2") && ok;
+    ok = test3("Test3") && ok;
+    return ok ? 0 : 1;
+}
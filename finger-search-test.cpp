@@ -0,0 +1,68 @@
+#include <iostream>
+#include <random>
+#include "avlbst.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    // from every finger, every key (and a miss between every pair) is found correctly
+    BinarySearchTree<int, int> bst;
+    AVLTree<int, int> avl;
+    mt19937 rng(42);
+    for (int i = 0; i < 200; ++i) {
+        int key = 2 * (int)(rng() % 300);
+        bst.insert(make_pair(key, key));
+        avl.insert(make_pair(key, key));
+    }
+    bool ok = true;
+    for (AVLTree<int, int>::iterator finger = avl.begin(); finger != avl.end(); ++finger) {
+        BinarySearchTree<int, int>::iterator bstFinger = bst.find(finger->first);
+        for (int key = -1; key <= 600; ++key) {
+            ok = ok && avl.find(key, finger) == avl.find(key);
+            ok = ok && bst.find(key, bstFinger) == bst.find(key);
+        }
+    }
+    ok = ok && avl.find(10, avl.end()) == avl.find(10);
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // a sequential walk by finger sees the same items as the iterator
+    AVLTree<int, long> tree;
+    for (int i = 0; i < 10000; ++i) {
+        tree.insert(make_pair(3 * i, (long)i));
+    }
+    AVLTree<int, long>::iterator finger = tree.begin();
+    bool ok = true;
+    for (int key = 0; key < 30000; ++key) {
+        AVLTree<int, long>::iterator found = tree.find(key, finger);
+        ok = ok && (found != tree.end()) == (key % 3 == 0);
+        if (found != tree.end()) {
+            ok = ok && found->second == key / 3;
+            finger = found;
+        }
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test3(const char* msg)
+{
+    // pending range updates are still applied to what a finger search returns
+    AVLTree<int, long, RangeAddAggregate<long> > tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(make_pair(i, 0L));
+    }
+    AVLTree<int, long, RangeAddAggregate<long> >::iterator finger = tree.find(500);
+    tree.updateRange(0, 999, 5L);
+    bool ok = tree.find(501, finger)->second == 5 && tree.find(10, finger)->second == 5;
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+}
@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "interval-tree.h"
+
+using namespace std;
+
+typedef IntervalTree<int, int> Tree;
+
+// Brute force list of the intervals overlapping [lo, hi], in key order.
+vector<pair<int, int> > expectedOverlaps(Tree& tree, int lo, int hi)
+{
+    vector<pair<int, int> > result;
+    for (Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        if (it->first.first <= hi && lo <= it->first.second) {
+            result.push_back(it->first);
+        }
+    }
+    return result;
+}
+
+void test1(const char* msg)
+{
+    Tree tree;
+    tree.insert(1, 5, 10);
+    tree.insert(3, 4, 20);
+    tree.insert(6, 9, 30);
+    tree.insert(3, 12, 40);
+    vector<Tree::iterator> out;
+    tree.overlapping(4, out);
+    bool ok = out.size() == 3 && out[0]->second == 10 && out[1]->second == 20 && out[2]->second == 40;
+    tree.overlapping(13, out);
+    ok = ok && out.empty();
+    tree.overlapping(9, 10, out);
+    ok = ok && out.size() == 2 && out[0]->second == 40 && out[1]->second == 30;
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // random inserts and erases, every query checked against a full scan
+    Tree tree;
+    srand(33);
+    bool ok = true;
+    for (int i = 0; i < 3000 && ok; ++i) {
+        int lo = rand() % 1000;
+        int hi = lo + rand() % 50;
+        if (rand() % 4 == 0) {
+            tree.erase(lo, hi);
+        }
+        else {
+            tree.insert(lo, hi, i);
+        }
+        int qlo = rand() % 1100 - 50;
+        int qhi = qlo + rand() % 30;
+        vector<Tree::iterator> out;
+        tree.overlapping(qlo, qhi, out);
+        vector<pair<int, int> > expected = expectedOverlaps(tree, qlo, qhi);
+        ok = (out.size() == expected.size());
+        for (size_t j = 0; ok && j < out.size(); ++j) {
+            ok = (out[j]->first == expected[j]);
+        }
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test3(const char* msg)
+{
+    Tree empty;
+    vector<Tree::iterator> out;
+    empty.overlapping(0, 100, out);
+    bool ok = out.empty();
+
+    // Point only needs operator<
+    IntervalTree<string, int> names;
+    names.insert("apple", "cherry", 1);
+    names.insert("banana", "date", 2);
+    names.insert("fig", "kiwi", 3);
+    vector<IntervalTree<string, int>::iterator> found;
+    names.overlapping("coconut", found);
+    ok = ok && found.size() == 1 && found[0]->second == 2;
+    names.overlapping("cherry", "grape", found);
+    ok = ok && found.size() == 3;
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+}
@@ -0,0 +1,152 @@
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* Aggregate policy for IntervalTree: the summary of a subtree is the largest right
+* endpoint of any interval in it. empty marks the identity, so Point only needs
+* operator< and a default constructor.
+*/
+template <typename Point, typename Value>
+struct IntervalAggregate : public NoRangeUpdates<Value>
+{
+    struct type
+    {
+        Point maxEnd;
+        bool empty;
+    };
+    static const bool enabled = true;
+    static type identity()
+    {
+        type summary = { Point(), true };
+        return summary;
+    }
+    static type lift(const std::pair<Point, Point>& interval, const Value&)
+    {
+        type summary = { interval.second, false };
+        return summary;
+    }
+    static type combine(const type& a, const type& b)
+    {
+        if (a.empty) {
+            return b;
+        }
+        if (b.empty || !(a.maxEnd < b.maxEnd)) {
+            return a;
+        }
+        return b;
+    }
+};
+
+/**
+* An AVL tree of closed intervals [lo, hi], each with a value. Items are keyed by the
+* (lo, hi) pair, so intervals with the same start can coexist, and iterate in order of
+* start. Every node caches the largest endpoint in its subtree (kept through rotations by
+* the AVLTree aggregate machinery), which lets overlap queries skip every subtree that
+* ends before the query starts. That pruning does not bound the subtrees entered by the
+* output size: one can reach lo yet hold only intervals that start after hi. A query
+* costs O(min(n, (k + 1) log n)) for k results: every subtree entered either holds a
+* result or hangs off the search path for hi.
+*/
+template <typename Point, typename Value>
+class IntervalTree : public AVLTree<std::pair<Point, Point>, Value, IntervalAggregate<Point, Value> >
+{
+public:
+    typedef AVLTree<std::pair<Point, Point>, Value, IntervalAggregate<Point, Value> > Base;
+    typedef typename Base::iterator iterator;
+
+    using Base::insert;
+    using Base::erase;
+    // Adds (or updates the value of) the interval [lo, hi].
+    void insert(const Point& lo, const Point& hi, const Value& value);
+    void erase(const Point& lo, const Point& hi);
+
+    // Stores an iterator to every interval containing point in out, in iteration order.
+    void overlapping(const Point& point, std::vector<iterator>& out) const;
+    // Stores an iterator to every interval that shares at least one point with [lo, hi].
+    void overlapping(const Point& lo, const Point& hi, std::vector<iterator>& out) const;
+
+private:
+    typedef AVLNode<std::pair<Point, Point>, Value, IntervalAggregate<Point, Value> > IntervalNode;
+
+    void overlappingHelper(IntervalNode* n, const Point& lo, const Point& hi, std::vector<iterator>& out) const;
+};
+
+/*
+-------------------------------------------------
+Begin implementations for the IntervalTree class.
+-------------------------------------------------
+*/
+
+/**
+* Inserts the interval [lo, hi]. lo must not be greater than hi.
+*/
+template<typename Point, typename Value>
+void IntervalTree<Point, Value>::insert(const Point& lo, const Point& hi, const Value& value)
+{
+    Base::insert(std::make_pair(std::make_pair(lo, hi), value));
+}
+
+/**
+* Removes the interval [lo, hi], if present.
+*/
+template<typename Point, typename Value>
+void IntervalTree<Point, Value>::erase(const Point& lo, const Point& hi)
+{
+    Base::erase(std::make_pair(lo, hi));
+}
+
+/**
+* Stabbing query: the intervals with lo <= point <= hi.
+*/
+template<typename Point, typename Value>
+void IntervalTree<Point, Value>::overlapping(const Point& point, std::vector<iterator>& out) const
+{
+    overlapping(point, point, out);
+}
+
+/**
+* Overlap query. [a, b] overlaps [lo, hi] exactly when a <= hi and lo <= b.
+*/
+template<typename Point, typename Value>
+void IntervalTree<Point, Value>::overlapping(const Point& lo, const Point& hi, std::vector<iterator>& out) const
+{
+    out.clear();
+    if (hi < lo) {
+        return;
+    }
+    overlappingHelper(static_cast<IntervalNode*>(this->mRoot), lo, hi, out);
+}
+
+/**
+* In-order walk that prunes a subtree when its largest endpoint is below lo, and the
+* right subtree when this node (and so everything after it) starts after hi. A subtree
+* that passes the first test may still hold no result, so the walk is
+* O(min(n, (k + 1) log n)), not O(log n + k).
+*/
+template<typename Point, typename Value>
+void IntervalTree<Point, Value>::overlappingHelper(IntervalNode* n, const Point& lo, const Point& hi, std::vector<iterator>& out) const
+{
+    if (n == NULL || n->getSummary().maxEnd < lo) {
+        return;
+    }
+    overlappingHelper(n->getLeft(), lo, hi, out);
+    if (hi < n->getKey().first) {
+        return;
+    }
+    if (!(n->getKey().second < lo) && !n->isErased()) {
+        out.push_back(iterator(n));
+    }
+    overlappingHelper(n->getRight(), lo, hi, out);
+}
+
+/*
+-----------------------------------------------
+End implementations for the IntervalTree class.
+-----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "cold-value-tree.h"
+#include "interval-tree.h"
+#include "test-items.h"
+
+using namespace std;
+
+// Tombstones still in the tree: the nodes validate() reaches beyond size().
+template <typename Tree>
+size_t tombstones(Tree& tree)
+{
+    size_t nodes = 0;
+    tree.validate(NULL, &nodes);
+    return nodes - tree.size();
+}
+
+void test1(const char* msg)
+{
+    // random inserts and erases match std::map through every lookup path
+    AVLTree<int, long> tree;
+    tree.setLazyErase(0.25);
+    tree.setFindCache(64);
+    tree.setMissFilter(true);
+    map<int, long> expected;
+    mt19937 rng(49);
+    bool ok = true;
+    size_t mostTombstones = 0;
+    for (int i = 0; i < 20000; ++i) {
+        int key = rng() % 1000;
+        if (rng() % 2 == 0) {
+            tree.erase(key);
+            expected.erase(key);
+        }
+        else {
+            tree.insert(make_pair(key, (long)i));
+            expected[key] = i;
+        }
+        int probe = rng() % 1000;
+        AVLTree<int, long>::iterator it = tree.find(probe);
+        bool present = expected.count(probe) != 0;
+        ok = ok && (present ? (it != tree.end() && it->second == expected[probe]) : it == tree.end());
+        ok = ok && tree.size() == expected.size();
+        if (i % 1000 == 0) {
+            ok = ok && treeMatches(tree, expected);
+            size_t dead = tombstones(tree);
+            ok = ok && dead * 4 <= dead + tree.size() + 1;
+            mostTombstones = max(mostTombstones, dead);
+        }
+    }
+    ok = ok && mostTombstones > 0 && treeMatches(tree, expected);
+
+    vector<int> keys;
+    for (int key = 0; key < 1000; key += 7) {
+        keys.push_back(key);
+    }
+    vector<AVLTree<int, long>::iterator> found;
+    tree.findMany(keys, found);
+    AVLTree<int, long>::iterator finger = tree.begin();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        bool present = expected.count(keys[i]) != 0;
+        ok = ok && (found[i] != tree.end()) == present;
+        AVLTree<int, long>::iterator near = tree.find(keys[i], finger);
+        ok = ok && (near != tree.end()) == present;
+        if (near != tree.end()) {
+            finger = near;
+        }
+        AVLTree<int, long>::iterator bound = tree.lowerBound(keys[i]);
+        map<int, long>::iterator want = expected.lower_bound(keys[i]);
+        ok = ok && (want == expected.end() ? bound == tree.end() : (bound != tree.end() && bound->first == want->first));
+    }
+
+    tree.setLazyErase(0);
+    ok = ok && tombstones(tree) == 0 && treeMatches(tree, expected);
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // aggregates and interval queries leave tombstones out; insert revives them
+    AVLTree<int, long, RangeAddAggregate<long> > sums;
+    sums.setLazyErase(0.5);
+    map<int, long> expected;
+    for (int i = 0; i < 500; ++i) {
+        sums.insert(make_pair(i, (long)i));
+        expected[i] = i;
+    }
+    for (int i = 0; i < 500; i += 3) {
+        sums.erase(i);
+        expected.erase(i);
+    }
+    sums.updateRange(100, 300, 10L);
+    for (map<int, long>::iterator it = expected.begin(); it != expected.end(); ++it) {
+        if (it->first >= 100 && it->first <= 300) {
+            it->second += 10;
+        }
+    }
+    sums.insert(make_pair(99, -1L));
+    expected[99] = -1;
+    long want = 0;
+    size_t wantCount = 0;
+    for (map<int, long>::iterator it = expected.lower_bound(50); it != expected.upper_bound(350); ++it) {
+        want += it->second;
+        ++wantCount;
+    }
+    RangeAddAggregate<long>::type got = sums.aggregate(50, 350);
+    bool ok = tombstones(sums) > 0 && got.sum == want && got.count == wantCount;
+    ok = ok && sums.aggregate(0, 499).count == expected.size() && treeMatches(sums, expected);
+
+    IntervalTree<int, int> intervals;
+    intervals.setLazyErase(0.9);
+    for (int i = 0; i < 100; ++i) {
+        intervals.insert(i, i + 10, i);
+    }
+    for (int i = 0; i < 100; i += 2) {
+        intervals.erase(i, i + 10);
+    }
+    vector<IntervalTree<int, int>::iterator> hits;
+    intervals.overlapping(50, hits);
+    ok = ok && hits.size() == 5;
+    for (size_t i = 0; i < hits.size(); ++i) {
+        ok = ok && hits[i]->first.first % 2 == 1;
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test3(const char* msg)
+{
+    // bulk operations and compaction with tombstones present, and a cold value tree
+    AVLTree<int, long> tree;
+    tree.setLazyErase(0.9);
+    map<int, long> expected;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(make_pair(i, (long)i));
+        expected[i] = i;
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        tree.erase(i);
+        expected.erase(i);
+    }
+    bool ok = tombstones(tree) == 500;
+    tree.erase_if([](const pair<int, long>& item) { return item.first % 3 == 0; });
+    for (map<int, long>::iterator it = expected.begin(); it != expected.end(); ) {
+        it = (it->first % 3 == 0) ? expected.erase(it) : ++it;
+    }
+    ok = ok && tombstones(tree) == 0 && treeMatches(tree, expected);
+
+    for (int i = 1; i < 1000; i += 10) {
+        tree.erase(i);
+        expected.erase(i);
+    }
+    tree.erase(tree.lowerBound(500), tree.lowerBound(900));
+    expected.erase(expected.lower_bound(500), expected.lower_bound(900));
+    ok = ok && treeMatches(tree, expected);
+    for (int i = 0; i < 100; ++i) {
+        tree.erase(i);
+        expected.erase(i);
+    }
+    tree.rebalance();
+    ok = ok && treeMatches(tree, expected);
+    tree.compact();
+    ok = ok && tombstones(tree) == 0 && treeMatches(tree, expected);
+
+    ColdValueTree<int, string> cold;
+    cold.setLazyErase(0.9);
+    for (int i = 0; i < 100; ++i) {
+        cold.insert(make_pair(i, to_string(i)));
+    }
+    for (int i = 0; i < 100; i += 2) {
+        cold.erase(i);
+    }
+    cold.insert(make_pair(10, string("ten")));
+    ok = ok && cold.size() == 51 && cold.findValue(12) == NULL && *cold.findValue(10) == "ten";
+    ok = ok && *cold.findValue(11) == "11";
+    cold.clear();
+    ok = ok && cold.empty() && tombstones(cold) == 0;
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <random>
+#include "avlbst.h"
+#include "counting-filter.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    // no false negatives, few false positives, and removal really removes
+    CountingBloomFilter filter(10000);
+    mt19937_64 rng(44);
+    vector<uint64_t> hashes(10000);
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        hashes[i] = rng();
+        filter.add(hashes[i]);
+    }
+    bool ok = true;
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        ok = ok && filter.mayContain(hashes[i]);
+    }
+    size_t falsePositives = 0;
+    for (int i = 0; i < 100000; ++i) {
+        falsePositives += filter.mayContain(rng());
+    }
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        filter.remove(hashes[i]);
+    }
+    size_t left = 0;
+    for (size_t i = 0; i < hashes.size(); ++i) {
+        left += filter.mayContain(hashes[i]);
+    }
+    cout << msg << ": " << (ok && falsePositives < 5000 && left == 0) << endl;
+}
+
+void test2(const char* msg)
+{
+    // the tree's filter follows inserts, growth and every kind of erase
+    AVLTree<int, int> tree;
+    tree.setMissFilter(true);
+    for (int i = 0; i < 20000; i += 2) {
+        tree.insert(make_pair(i, i));
+    }
+    tree.erase(100);
+    tree.erase(tree.find(200));
+    tree.erase(tree.find(1000), tree.find(3000));
+    tree.erase_if([](const pair<int, int>& item) { return item.first % 6 == 0; });
+    bool ok = true;
+    for (int i = 0; i < 20000; ++i) {
+        bool present = i % 2 == 0 && i % 6 != 0 && i != 100 && i != 200 && (i < 1000 || i >= 3000);
+        ok = ok && (tree.find(i) != tree.end()) == present;
+    }
+    tree.clear();
+    tree.insert(make_pair(7, 7));
+    ok = ok && tree.find(7) != tree.end() && tree.find(8) == tree.end();
+    cout << msg << ": " << (ok && tree.validate()) << endl;
+}
+
+void test3(const char* msg)
+{
+    // a bulk build grows past the filter's capacity without losing any key
+    AVLTree<int, int> tree;
+    tree.setMissFilter(true);
+    vector<pair<int, int> > items;
+    for (int i = 0; i < 5000; ++i) {
+        items.push_back(make_pair(i * 2, i));
+    }
+    tree.assignSorted(items.begin(), items.end());
+    bool ok = tree.size() == 5000;
+    for (int i = 0; i < 10000; ++i) {
+        ok = ok && (tree.find(i) != tree.end()) == (i % 2 == 0);
+    }
+    for (int i = 10000; i < 12000; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    ok = ok && tree.find(0) != tree.end() && tree.find(11999) != tree.end();
+    cout << msg << ": " << (ok && tree.validate()) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+}
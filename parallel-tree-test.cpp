@@ -0,0 +1,167 @@
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "avlbst.h"
+#include "parallel-tree.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    AVLTree<int, int> tree;
+    for (int i = 1; i <= 100000; ++i) {
+        tree.insert(make_pair(i, i % 7));
+    }
+    WorkStealingPool pool(4);
+    atomic<long> count(0), sum(0);
+    parallelForEach(tree, [&](pair<int, int>& item) {
+        ++count;
+        sum += item.second;
+    }, pool);
+
+    long expected = 0;
+    for (AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        expected += it->second;
+    }
+    cout << msg << ": " << (count == 100000 && sum == expected) << endl;
+}
+
+void test2(const char* msg)
+{
+    // string concatenation is associative but not commutative, so this checks that the
+    // partial results are combined in key order
+    AVLTree<int, char> tree;
+    string expected;
+    for (int i = 0; i < 5000; ++i) {
+        tree.insert(make_pair(i, (char)('a' + i % 26)));
+        expected += (char)('a' + i % 26);
+    }
+    WorkStealingPool pool(4);
+    string result = parallelReduce(
+            tree,
+            string(),
+            [](const string& acc, const pair<int, char>& item) { return acc + item.second; },
+            [](const string& a, const string& b) { return a + b; },
+            pool);
+    cout << msg << ": " << (result == expected) << endl;
+}
+
+void test3(const char* msg)
+{
+    AVLTree<int, int> empty;
+    long sum = parallelReduce(
+            empty,
+            0L,
+            [](long acc, const pair<int, int>& item) { return acc + item.second; },
+            [](long a, long b) { return a + b; });
+    cout << msg << ": " << (sum == 0) << endl;
+}
+
+void test4(const char* msg)
+{
+    // tombstones left by a lazy erase are not visited
+    AVLTree<int, int> tree;
+    tree.setLazyErase(0.5);
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    for (int i = 0; i < 100; i += 5) {
+        tree.erase(i);
+    }
+    WorkStealingPool pool(4);
+    atomic<long> count(0);
+    parallelForEach(tree, [&](pair<int, int>& item) {
+        count += (item.first % 5 == 0) ? 1000 : 1;
+    }, pool);
+    long sum = parallelReduce(
+            tree,
+            0L,
+            [](long acc, const pair<int, int>& item) { return acc + item.second; },
+            [](long a, long b) { return a + b; },
+            pool);
+    cout << msg << ": " << (tree.size() == 80 && count == 80 && sum == 4950 - 950) << endl;
+}
+
+void test5(const char* msg)
+{
+    // pending range updates are pushed down before any value is read
+    AVLTree<int, long, RangeAddAggregate<long> > tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, 0L));
+    }
+    tree.updateRange(0, 99, 5L);
+    WorkStealingPool pool(4);
+    long sum = parallelReduce(
+            tree,
+            0L,
+            [](long acc, const pair<int, long>& item) { return acc + item.second; },
+            [](long a, long b) { return a + b; },
+            pool);
+    tree.updateRange(50, 99, 1L);
+    atomic<long> visited(0);
+    parallelForEach(tree, [&](pair<int, long>& item) {
+        visited += item.second;
+    }, pool);
+    cout << msg << ": " << (sum == 500 && visited == 550) << endl;
+}
+
+void test6(const char* msg)
+{
+    // an exception from fn or fold, on a worker or on the calling thread, reaches the caller
+    AVLTree<int, int> tree;
+    for (int i = 0; i < 10000; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    WorkStealingPool pool(4);
+    bool ok = true;
+    for (int bad = 0; bad < 10000; bad += 1111) {
+        bool caught = false;
+        try {
+            parallelForEach(tree, [bad](pair<int, int>& item) {
+                if (item.first == bad) {
+                    throw runtime_error("fn");
+                }
+            }, pool);
+        }
+        catch (const runtime_error& e) {
+            caught = string(e.what()) == "fn";
+        }
+        ok = ok && caught;
+        caught = false;
+        try {
+            parallelReduce(
+                    tree,
+                    0L,
+                    [bad](long acc, const pair<int, int>& item) {
+                        if (item.first == bad) {
+                            throw runtime_error("fold");
+                        }
+                        return acc + item.second;
+                    },
+                    [](long a, long b) { return a + b; },
+                    pool);
+        }
+        catch (const runtime_error& e) {
+            caught = string(e.what()) == "fold";
+        }
+        ok = ok && caught;
+    }
+    long sum = parallelReduce(
+            tree,
+            0L,
+            [](long acc, const pair<int, int>& item) { return acc + item.second; },
+            [](long a, long b) { return a + b; },
+            pool);
+    cout << msg << ": " << (ok && sum == 49995000L) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+    test4("Test4");
+    test5("Test5");
+    test6("Test6");
+}
@@ -0,0 +1,385 @@
+#ifndef PARALLEL_TREE_H
+#define PARALLEL_TREE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* A fixed-size thread pool with one task deque per worker. Workers pop their own newest
+* task first (keeping recently split subtrees hot in their cache) and, when they run
+* dry, steal the oldest task from another worker, which is usually the largest piece of
+* remaining work. Threads waiting on a TaskGroup run queued tasks instead of blocking,
+* so nested fork/join never deadlocks.
+*/
+class WorkStealingPool
+{
+public:
+    // A set of tasks that can be waited on together. A task that throws does not stop
+    // the others; the first exception is kept and rethrown by wait().
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup(WorkStealingPool& pool) : mPool(pool), mPending(0) {}
+        // Waits for the tasks but drops any exception, so it is safe during unwinding.
+        ~TaskGroup() { drain(); }
+
+        void run(std::function<void()> task);
+        // Runs queued tasks until every task in this group has finished, then rethrows
+        // the first exception a task threw, if any.
+        void wait();
+
+    private:
+        TaskGroup(const TaskGroup&);
+        TaskGroup& operator=(const TaskGroup&);
+
+        void drain();
+
+        WorkStealingPool& mPool;
+        std::atomic<size_t> mPending;
+        std::mutex mErrorLock;
+        std::exception_ptr mError;
+    };
+
+    explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+
+    size_t size() const { return mWorkers.size(); }
+
+    // A pool with one worker per hardware thread, created on first use.
+    static WorkStealingPool& shared();
+
+private:
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    void push(std::function<void()> task);
+    bool tryRunOne();
+    void workerLoop(size_t index);
+
+    std::vector<Worker*> mWorkers;
+    std::vector<std::thread> mThreads;
+    std::atomic<size_t> mQueued;
+    std::atomic<size_t> mNextWorker;
+    std::atomic<bool> mStopping;
+    std::mutex mSleepLock;
+    std::condition_variable mWakeup;
+
+    // Which pool and worker the current thread belongs to, if any.
+    inline static thread_local WorkStealingPool* tlsPool = NULL;
+    inline static thread_local size_t tlsIndex = 0;
+};
+
+/*
+----------------------------------------------------
+Begin implementations for the WorkStealingPool class.
+----------------------------------------------------
+*/
+
+/**
+* Starts the worker threads.
+*/
+inline WorkStealingPool::WorkStealingPool(size_t threads)
+    : mQueued(0)
+    , mNextWorker(0)
+    , mStopping(false)
+{
+    if (threads == 0) {
+        threads = 1;
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        mWorkers.push_back(new Worker);
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        mThreads.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+}
+
+/**
+* Stops and joins the workers. Any task still queued is dropped.
+*/
+inline WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(mSleepLock);
+        mStopping.store(true);
+    }
+    mWakeup.notify_all();
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        mThreads[i].join();
+    }
+    for (size_t i = 0; i < mWorkers.size(); ++i) {
+        delete mWorkers[i];
+    }
+}
+
+/**
+* Returns the process-wide pool.
+*/
+inline WorkStealingPool& WorkStealingPool::shared()
+{
+    static WorkStealingPool pool;
+    return pool;
+}
+
+/**
+* Queues a task on the calling worker's own deque, or spreads tasks from outside threads
+* round robin across the workers.
+*/
+inline void WorkStealingPool::push(std::function<void()> task)
+{
+    size_t index = (tlsPool == this) ? tlsIndex : mNextWorker.fetch_add(1) % mWorkers.size();
+    {
+        std::lock_guard<std::mutex> guard(mWorkers[index]->lock);
+        mWorkers[index]->tasks.push_back(std::move(task));
+    }
+    mQueued.fetch_add(1);
+    mWakeup.notify_one();
+}
+
+/**
+* Runs one task if any is available: the newest task of our own deque, otherwise the
+* oldest task of the first other deque that has one. Returns false if every deque was
+* empty.
+*/
+inline bool WorkStealingPool::tryRunOne()
+{
+    std::function<void()> task;
+    bool own = (tlsPool == this);
+    if (own) {
+        Worker& worker = *mWorkers[tlsIndex];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (!worker.tasks.empty()) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+    }
+
+    size_t start = own ? tlsIndex + 1 : 0;
+    for (size_t i = 0; !task && i < mWorkers.size(); ++i) {
+        Worker& victim = *mWorkers[(start + i) % mWorkers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+    mQueued.fetch_sub(1);
+    task();
+    return true;
+}
+
+/**
+* Runs tasks until the pool is destroyed, sleeping while there is nothing to do.
+*/
+inline void WorkStealingPool::workerLoop(size_t index)
+{
+    tlsPool = this;
+    tlsIndex = index;
+    while (!mStopping.load()) {
+        if (tryRunOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(mSleepLock);
+        mWakeup.wait_for(guard, std::chrono::milliseconds(10), [this] {
+            return mStopping.load() || mQueued.load() > 0;
+        });
+    }
+}
+
+/**
+* Queues task as part of this group. Whatever task throws is caught here, so it never
+* escapes a worker thread (which would terminate the process) or a waiting thread that
+* runs it, and the task is always counted as finished.
+*/
+inline void WorkStealingPool::TaskGroup::run(std::function<void()> task)
+{
+    mPending.fetch_add(1);
+    mPool.push([this, task] {
+        try {
+            task();
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> guard(mErrorLock);
+            if (!mError) {
+                mError = std::current_exception();
+            }
+        }
+        mPending.fetch_sub(1);
+    });
+}
+
+/**
+* Drains the group, then hands on the first exception.
+*/
+inline void WorkStealingPool::TaskGroup::wait()
+{
+    drain();
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> guard(mErrorLock);
+        error.swap(mError);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+* Helps run tasks while waiting for the group to drain.
+*/
+inline void WorkStealingPool::TaskGroup::drain()
+{
+    while (mPending.load() != 0) {
+        if (!mPool.tryRunOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/*
+--------------------------------------------------
+End implementations for the WorkStealingPool class.
+--------------------------------------------------
+*/
+
+/**
+* Number of tree levels to split into separate tasks: enough that every worker gets
+* about eight subtrees, so stealing can even out subtrees of different sizes. The tree
+* only needs to be roughly balanced (as an AVLTree is) for the pieces to be similar.
+*/
+inline size_t parallelSplitDepth(size_t threads)
+{
+    size_t depth = 0;
+    while (((size_t)1 << depth) < threads * 8) {
+        ++depth;
+    }
+    return (threads <= 1) ? 0 : depth;
+}
+
+/**
+* Sequential in-order walk of a subtree with an explicit stack. Tombstones left by a
+* lazy erase are skipped, as the tree's iterators skip them.
+*/
+template <typename Key, typename Value, typename Fn>
+void inOrderVisit(Node<Key, Value>* node, Fn& fn)
+{
+    std::vector<Node<Key, Value>*> stack;
+    while (node != NULL || !stack.empty()) {
+        while (node != NULL) {
+            stack.push_back(node);
+            node = node->getLeft();
+        }
+        node = stack.back();
+        stack.pop_back();
+        if (!node->isErased()) {
+            fn(node->getItem());
+        }
+        node = node->getRight();
+    }
+}
+
+/**
+* Splits the subtree at node into one task per child until depth runs out, then walks
+* the remaining subtree on the current thread.
+*/
+template <typename Key, typename Value, typename Fn>
+void parallelForEachHelper(Node<Key, Value>* node, size_t depth, Fn& fn, WorkStealingPool::TaskGroup& group)
+{
+    if (node == NULL) {
+        return;
+    }
+    if (depth == 0) {
+        inOrderVisit(node, fn);
+        return;
+    }
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* right = node->getRight();
+    group.run([left, depth, &fn, &group] { parallelForEachHelper(left, depth - 1, fn, group); });
+    group.run([right, depth, &fn, &group] { parallelForEachHelper(right, depth - 1, fn, group); });
+    if (!node->isErased()) {
+        fn(node->getItem());
+    }
+}
+
+/**
+* Calls fn(item) for every item of tree, in no particular order, spread across the pool.
+* fn is shared by all workers, so it must be safe to call concurrently. The tree must not
+* be modified until the call returns. Pending range updates are flushed first, so every
+* value fn sees is exact. If fn throws, the tasks already queued still run, and the first
+* exception is rethrown once they have finished.
+*/
+template <typename Key, typename Value, typename Allocator, typename Fn>
+void parallelForEach(const BinarySearchTree<Key, Value, Allocator>& tree, Fn fn, WorkStealingPool& pool = WorkStealingPool::shared())
+{
+    tree.flushUpdates();
+    WorkStealingPool::TaskGroup group(pool);
+    parallelForEachHelper(tree.mRoot, parallelSplitDepth(pool.size()), fn, group);
+    group.wait();
+}
+
+/**
+* Reduces the subtree at node. The left subtree is handed to the pool while this thread
+* reduces the right one, and the results are combined in key order.
+*/
+template <typename Key, typename Value, typename T, typename Fold, typename Combine>
+T parallelReduceHelper(Node<Key, Value>* node, size_t depth, const T& identity, Fold& fold, Combine& combine, WorkStealingPool& pool)
+{
+    if (node == NULL) {
+        return identity;
+    }
+    if (depth == 0) {
+        T result = identity;
+        auto visit = [&result, &fold](const std::pair<Key, Value>& item) { result = fold(result, item); };
+        inOrderVisit(node, visit);
+        return result;
+    }
+
+    T leftResult = identity;
+    Node<Key, Value>* left = node->getLeft();
+    WorkStealingPool::TaskGroup group(pool);
+    group.run([&leftResult, left, depth, &identity, &fold, &combine, &pool] {
+        leftResult = parallelReduceHelper(left, depth - 1, identity, fold, combine, pool);
+    });
+    T rightResult = parallelReduceHelper(node->getRight(), depth - 1, identity, fold, combine, pool);
+    group.wait();
+    if (!node->isErased()) {
+        leftResult = fold(leftResult, node->getItem());
+    }
+    return combine(leftResult, rightResult);
+}
+
+/**
+* Reduces every item of tree in parallel. fold(T, item) adds one item to a partial
+* result and combine(T, T) merges two partial results; each worker starts from identity.
+* Partial results are combined in key order, so combine only needs to be associative,
+* not commutative. The tree must not be modified until the call returns. Pending range
+* updates are flushed first, and exceptions from fold or combine are handled, as in
+* parallelForEach.
+*/
+template <typename Key, typename Value, typename Allocator, typename T, typename Fold, typename Combine>
+T parallelReduce(const BinarySearchTree<Key, Value, Allocator>& tree, T identity, Fold fold, Combine combine, WorkStealingPool& pool = WorkStealingPool::shared())
+{
+    tree.flushUpdates();
+    return parallelReduceHelper(tree.mRoot, parallelSplitDepth(pool.size()), identity, fold, combine, pool);
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "avlbst.h"
+#include "prefix-string.h"
+
+using namespace std;
+
+// Strings over a tiny alphabet (including a high byte and NUL) with shared prefixes of
+// every length, so every branch of the comparison is exercised.
+vector<string> sampleStrings()
+{
+    mt19937 rng(41);
+    const char alphabet[] = {'a', 'b', (char)0xe9, '\0'};
+    vector<string> strings;
+    for (int i = 0; i < 400; ++i) {
+        string s(rng() % 24, 'a');
+        for (size_t j = 0; j < s.size(); ++j) {
+            s[j] = (rng() % 3 == 0) ? alphabet[rng() % 4] : 'a';
+        }
+        strings.push_back(s);
+    }
+    return strings;
+}
+
+void test1(const char* msg)
+{
+    // orders and compares exactly like std::string
+    vector<string> strings = sampleStrings();
+    bool ok = true;
+    for (size_t i = 0; i < strings.size(); ++i) {
+        for (size_t j = 0; j < strings.size(); ++j) {
+            PrefixString a(strings[i]), b(strings[j]);
+            ok = ok && (a < b) == (strings[i] < strings[j]);
+            ok = ok && (a == b) == (strings[i] == strings[j]);
+        }
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // works as a tree key
+    AVLTree<PrefixString, int> tree;
+    tree.insert(make_pair(PrefixString("https://example.com/a/very/long/path"), 1));
+    tree.insert(make_pair(PrefixString("https://example.com/a/very/long/path/2"), 2));
+    tree.insert(make_pair(PrefixString("/usr/lib"), 3));
+    tree.insert(make_pair(PrefixString("https://example.com/a/very/long/path"), 4));
+    string order;
+    for (AVLTree<PrefixString, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        order += to_string(it->second);
+    }
+    bool ok = order == "342" && tree.find(string("/usr/lib")) != tree.end();
+    ok = ok && tree.find("https://example.com/a/very/long/pat") == tree.end();
+    cout << msg << ": " << (ok && tree.validate()) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+}
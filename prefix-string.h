@@ -0,0 +1,144 @@
+#ifndef PREFIX_STRING_H
+#define PREFIX_STRING_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+* A string key that carries its first PREFIX_BYTES bytes inline, packed big-endian into
+* integers, so that comparing two keys compares those integers first. Long strings keep
+* their characters on the heap, and with plain std::string keys every comparison during
+* a tree descent follows that pointer: one extra cache miss per level. Keys that differ
+* in their first PREFIX_BYTES bytes (or where the shorter key ends within them) are
+* ordered without touching the heap at all.
+*
+* Use it as the Key of any tree, e.g. AVLTree<PrefixString, Value>. It converts
+* implicitly from std::string and const char*, and orders exactly like std::string.
+*/
+class PrefixString
+{
+public:
+    static const size_t PREFIX_BYTES = 16;
+
+    PrefixString();
+    PrefixString(const std::string& text);
+    PrefixString(const char* text);
+
+    const std::string& str() const { return mText; }
+    size_t size() const { return mText.size(); }
+
+    bool operator<(const PrefixString& other) const;
+    bool operator==(const PrefixString& other) const;
+    bool operator!=(const PrefixString& other) const { return !(*this == other); }
+    bool operator>(const PrefixString& other) const { return other < *this; }
+
+private:
+    void loadPrefix();
+    // Compares the two keys, given that their prefixes are equal: <0, 0 or >0.
+    int compareTail(const PrefixString& other) const;
+
+    // Bytes 0-7 and 8-15 of the string, big-endian, zero padded past its end.
+    uint64_t mHigh;
+    uint64_t mLow;
+    std::string mText;
+};
+
+/*
+-------------------------------------------------
+Begin implementations for the PrefixString class.
+-------------------------------------------------
+*/
+
+/**
+* Constructors. The prefix is computed once, here.
+*/
+inline PrefixString::PrefixString()
+    : mHigh(0), mLow(0)
+{
+
+}
+
+inline PrefixString::PrefixString(const std::string& text)
+    : mText(text)
+{
+    loadPrefix();
+}
+
+inline PrefixString::PrefixString(const char* text)
+    : mText(text)
+{
+    loadPrefix();
+}
+
+/**
+* Packs the first PREFIX_BYTES bytes so that comparing the integers orders them the way
+* std::string compares characters (as unsigned char).
+*/
+inline void PrefixString::loadPrefix()
+{
+    mHigh = 0;
+    mLow = 0;
+    for (size_t i = 0; i < PREFIX_BYTES; ++i) {
+        uint64_t byte = (i < mText.size()) ? (unsigned char)mText[i] : 0;
+        if (i < 8) {
+            mHigh = (mHigh << 8) | byte;
+        }
+        else {
+            mLow = (mLow << 8) | byte;
+        }
+    }
+}
+
+/**
+* With equal prefixes, a key that ends within the prefix is a prefix of the other one,
+* so the lengths decide. Only when both keys are longer are their heap bytes compared.
+*/
+inline int PrefixString::compareTail(const PrefixString& other) const
+{
+    if (mText.size() <= PREFIX_BYTES || other.mText.size() <= PREFIX_BYTES) {
+        return (mText.size() < other.mText.size()) ? -1 : (mText.size() > other.mText.size());
+    }
+    return mText.compare(PREFIX_BYTES, std::string::npos, other.mText, PREFIX_BYTES, std::string::npos);
+}
+
+/**
+* Orders like std::string.
+*/
+inline bool PrefixString::operator<(const PrefixString& other) const
+{
+    if (mHigh != other.mHigh) {
+        return mHigh < other.mHigh;
+    }
+    if (mLow != other.mLow) {
+        return mLow < other.mLow;
+    }
+    return compareTail(other) < 0;
+}
+
+/**
+* Equality, rejecting on the prefix or the length before comparing characters.
+*/
+inline bool PrefixString::operator==(const PrefixString& other) const
+{
+    if (mHigh != other.mHigh || mLow != other.mLow || mText.size() != other.mText.size()) {
+        return false;
+    }
+    return compareTail(other) == 0;
+}
+
+/**
+* Prints the string itself.
+*/
+inline std::ostream& operator<<(std::ostream& out, const PrefixString& key)
+{
+    return out << key.str();
+}
+
+/*
+-----------------------------------------------
+End implementations for the PrefixString class.
+-----------------------------------------------
+*/
+
+#endif
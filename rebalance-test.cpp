@@ -0,0 +1,90 @@
+#include <iostream>
+#include <vector>
+#include "avlbst.h"
+
+using namespace std;
+
+// Height of the subtree at node, without recursion (the input may be a long chain).
+template <typename Key, typename Value>
+int height(Node<Key, Value>* root)
+{
+    int best = 0;
+    vector<pair<Node<Key, Value>*, int> > stack;
+    if (root != NULL) {
+        stack.push_back(make_pair(root, 1));
+    }
+    while (!stack.empty()) {
+        Node<Key, Value>* node = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        best = max(best, depth);
+        if (node->getLeft() != NULL) {
+            stack.push_back(make_pair(node->getLeft(), depth + 1));
+        }
+        if (node->getRight() != NULL) {
+            stack.push_back(make_pair(node->getRight(), depth + 1));
+        }
+    }
+    return best;
+}
+
+// Smallest possible height for n nodes.
+int minimumHeight(size_t n)
+{
+    int h = 0;
+    while (((size_t)1 << h) - 1 < n) {
+        ++h;
+    }
+    return h;
+}
+
+void test1(const char* msg)
+{
+    // a sorted chain of any size becomes minimal height, keeping order and iterators
+    bool ok = true;
+    for (int n = 0; n <= 300; ++n) {
+        BinarySearchTree<int, int> tree;
+        for (int i = 0; i < n; ++i) {
+            tree.insert(make_pair(i, i));
+        }
+        BinarySearchTree<int, int>::iterator middle = tree.find(n / 2);
+        tree.rebalance();
+        ok = ok && height(tree.mRoot) == minimumHeight(n) && tree.validate();
+        ok = ok && (n == 0 || (tree.find(n / 2) == middle && middle->second == n / 2));
+        int expected = 0;
+        for (BinarySearchTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            ok = ok && it->first == expected++;
+        }
+        ok = ok && expected == n;
+    }
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // a long descending chain, and a zig-zag, on a tree with derived nodes
+    BinarySearchTree<int, int> chain;
+    for (int i = 20000; i > 0; --i) {
+        chain.insert(make_pair(i, i));
+    }
+    chain.rebalance();
+    bool ok = height(chain.mRoot) == minimumHeight(20000) && chain.validate();
+
+    AVLTree<int, long, RangeAddAggregate<long> > tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(make_pair(i, (long)i));
+    }
+    tree.erase_if([](const pair<int, long>& item) { return item.first % 3 != 0 && item.first > 100; });
+    tree.updateRange(0, 500, 1L);
+    long before = tree.aggregate(0, 999).sum;
+    tree.rebalance();
+    ok = ok && tree.validate() && tree.aggregate(0, 999).sum == before;
+    ok = ok && height(tree.mRoot) == minimumHeight(tree.size());
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+}
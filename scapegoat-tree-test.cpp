@@ -0,0 +1,82 @@
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+#include "scapegoat-tree.h"
+
+using namespace std;
+
+// Height of the tree, counted in nodes.
+template <typename Key, typename Value>
+int height(Node<Key, Value>* node)
+{
+    if (node == NULL) {
+        return 0;
+    }
+    return 1 + max(height(node->getLeft()), height(node->getRight()));
+}
+
+// The height bound a scapegoat tree with alpha = 2/3 guarantees after an insert.
+int heightBound(size_t n)
+{
+    return (n == 0) ? 0 : 2 + (int)floor(log((double)n) / log(1.5));
+}
+
+void test1(const char* msg)
+{
+    // sorted inserts, which make a plain BST a chain, stay logarithmic
+    ScapegoatTree<int, int> tree;
+    bool ok = true;
+    for (int i = 0; i < 100000; ++i) {
+        tree.insert(make_pair(i, i));
+        if ((i & (i + 1)) == 0) {
+            ok = ok && height(tree.mRoot) <= heightBound(tree.size());
+        }
+    }
+    for (int i = 100000; i > 0; i -= 2) {
+        tree.insert(make_pair(i * 2 + 1000000, i));
+    }
+    ok = ok && height(tree.mRoot) <= heightBound(tree.size()) && tree.validate();
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // random inserts, updates and erases match std::map
+    ScapegoatTree<int, int> tree;
+    map<int, int> expected;
+    mt19937 rng(46);
+    bool ok = true;
+    for (int i = 0; i < 200000; ++i) {
+        int key = rng() % 5000;
+        if (rng() % 3 == 0) {
+            tree.erase(key);
+            expected.erase(key);
+        }
+        else {
+            tree.insert(make_pair(key, i));
+            expected[key] = i;
+        }
+    }
+    ok = ok && tree.validate() && tree.size() == expected.size();
+    map<int, int>::iterator want = expected.begin();
+    for (ScapegoatTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it, ++want) {
+        ok = ok && it->first == want->first && it->second == want->second;
+    }
+
+    // erasing most of the tree triggers full rebuilds that keep it short
+    for (int key = 0; key < 5000; ++key) {
+        if (key % 50 != 0) {
+            tree.erase(key);
+        }
+    }
+    ok = ok && tree.validate() && height(tree.mRoot) <= heightBound(tree.size());
+    cout << msg << ": " << ok << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+}
@@ -0,0 +1,208 @@
+#ifndef SCAPEGOAT_TREE_H
+#define SCAPEGOAT_TREE_H
+
+#include <cmath>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* A scapegoat tree: a self-balancing search tree that stores nothing in its nodes beyond
+* what BinarySearchTree does, so it uses the plain (smallest) Node. Balance is tracked
+* only globally, by the node count and the largest count since the last full rebuild.
+*
+* An insert that lands deeper than log base 3/2 of the size walks back up to the first
+* ancestor whose child subtree holds more than 2/3 of its nodes (the scapegoat) and
+* rebuilds that subtree perfectly balanced. Once erasures have shrunk the tree below 2/3
+* of its largest size, the whole tree is rebalanced. Height stays O(log n), and insert
+* and erase are amortized O(log n).
+*/
+template <typename Key, typename Value, typename Allocator = std::allocator<std::pair<Key, Value> > >
+class ScapegoatTree : public BinarySearchTree<Key, Value, Allocator>
+{
+public:
+    explicit ScapegoatTree(const Allocator& allocator = Allocator());
+
+    virtual void insert(const std::pair<Key, Value>& keyValuePair) override;
+
+protected:
+    // Every erase path removes through here, so this is where shrinkage is noticed.
+    virtual void removeNode(Node<Key, Value>* node) override;
+
+private:
+    // The balance parameter alpha = 2/3.
+    static const size_t ALPHA_NUMERATOR = 2;
+    static const size_t ALPHA_DENOMINATOR = 3;
+
+    // True when a node at depth (edges from the root) is too deep for the current size.
+    bool tooDeep(size_t depth) const;
+    size_t subtreeSize(Node<Key, Value>* node) const;
+    void rebuildSubtree(Node<Key, Value>* root);
+
+    // The size the last full rebuild is measured against.
+    size_t mMaxSize;
+};
+
+/*
+-------------------------------------------------
+Begin implementations for the ScapegoatTree class.
+-------------------------------------------------
+*/
+
+/**
+* Constructor.
+*/
+template<typename Key, typename Value, typename Allocator>
+ScapegoatTree<Key, Value, Allocator>::ScapegoatTree(const Allocator& allocator)
+    : BinarySearchTree<Key, Value, Allocator>(allocator),
+      mMaxSize(0)
+{
+
+}
+
+/**
+* Inserts like an unbalanced BST, remembering the depth of the new leaf. If it is too
+* deep, the sizes of its ancestors are counted on the way up until one is unbalanced
+* enough to rebuild; one must be, or the leaf could not be that deep.
+*/
+template<typename Key, typename Value, typename Allocator>
+void ScapegoatTree<Key, Value, Allocator>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    const Key& key = keyValuePair.first;
+    if (this->mRoot == NULL) {
+        this->mRoot = this->createNode(key, keyValuePair.second, NULL);
+        mMaxSize = std::max(mMaxSize, this->mSize);
+        return;
+    }
+
+    Node<Key, Value>* parent = this->mRoot;
+    size_t depth = 1;
+    Node<Key, Value>* node = NULL;
+    while (node == NULL) {
+        if (key < parent->getKey()) {
+            if (parent->getLeft() == NULL) {
+                node = this->createNode(key, keyValuePair.second, parent);
+                parent->setLeft(node);
+            }
+            else {
+                parent = parent->getLeft();
+                ++depth;
+            }
+        }
+        else if (parent->getKey() < key) {
+            if (parent->getRight() == NULL) {
+                node = this->createNode(key, keyValuePair.second, parent);
+                parent->setRight(node);
+            }
+            else {
+                parent = parent->getRight();
+                ++depth;
+            }
+        }
+        else {
+            parent->setValue(keyValuePair.second);
+            return;
+        }
+    }
+    mMaxSize = std::max(mMaxSize, this->mSize);
+    if (!tooDeep(depth)) {
+        return;
+    }
+
+    size_t childSize = 1;
+    Node<Key, Value>* child = node;
+    while (parent != NULL) {
+        Node<Key, Value>* sibling = (child == parent->getLeft()) ? parent->getRight() : parent->getLeft();
+        size_t parentSize = childSize + 1 + subtreeSize(sibling);
+        if (childSize * ALPHA_DENOMINATOR > parentSize * ALPHA_NUMERATOR) {
+            rebuildSubtree(parent);
+            return;
+        }
+        child = parent;
+        childSize = parentSize;
+        parent = parent->getParent();
+    }
+}
+
+/**
+* Unbalanced removal, then a full rebalance once the tree has lost a third of its
+* largest size since the last one.
+*/
+template<typename Key, typename Value, typename Allocator>
+void ScapegoatTree<Key, Value, Allocator>::removeNode(Node<Key, Value>* node)
+{
+    BinarySearchTree<Key, Value, Allocator>::removeNode(node);
+    if (this->mSize * ALPHA_DENOMINATOR < mMaxSize * ALPHA_NUMERATOR) {
+        this->rebalance();
+        mMaxSize = this->mSize;
+    }
+}
+
+/**
+* depth > log base 1/alpha of the size.
+*/
+template<typename Key, typename Value, typename Allocator>
+bool ScapegoatTree<Key, Value, Allocator>::tooDeep(size_t depth) const
+{
+    static const double logInverseAlpha = std::log((double)ALPHA_DENOMINATOR / ALPHA_NUMERATOR);
+    return (double)depth > std::log((double)this->mSize) / logInverseAlpha;
+}
+
+/**
+* Counts the nodes below node with an explicit stack.
+*/
+template<typename Key, typename Value, typename Allocator>
+size_t ScapegoatTree<Key, Value, Allocator>::subtreeSize(Node<Key, Value>* node) const
+{
+    size_t count = 0;
+    std::vector<Node<Key, Value>*> stack;
+    if (node != NULL) {
+        stack.push_back(node);
+    }
+    while (!stack.empty()) {
+        Node<Key, Value>* n = stack.back();
+        stack.pop_back();
+        ++count;
+        if (n->getLeft() != NULL) {
+            stack.push_back(n->getLeft());
+        }
+        if (n->getRight() != NULL) {
+            stack.push_back(n->getRight());
+        }
+    }
+    return count;
+}
+
+/**
+* Relinks the subtree at root, in key order, into a perfectly balanced subtree hanging
+* from the same parent.
+*/
+template<typename Key, typename Value, typename Allocator>
+void ScapegoatTree<Key, Value, Allocator>::rebuildSubtree(Node<Key, Value>* root)
+{
+    std::vector<Node<Key, Value>*> nodes;
+    std::vector<Node<Key, Value>*> stack;
+    Node<Key, Value>* n = root;
+    while (n != NULL || !stack.empty()) {
+        while (n != NULL) {
+            stack.push_back(n);
+            n = n->getLeft();
+        }
+        n = stack.back();
+        stack.pop_back();
+        nodes.push_back(n);
+        n = n->getRight();
+    }
+    Node<Key, Value>* parent = root->getParent();
+    int height;
+    Node<Key, Value>* rebuilt = this->buildBalanced(nodes, 0, nodes.size(), parent, height);
+    this->replaceChild(parent, root, rebuilt);
+}
+
+/*
+-----------------------------------------------
+End implementations for the ScapegoatTree class.
+-----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,177 @@
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "sharded-tree.h"
+
+using namespace std;
+
+vector<int> boundaries()
+{
+    vector<int> result;
+    result.push_back(1000);
+    result.push_back(2000);
+    result.push_back(3000);
+    return result;
+}
+
+bool inOrder(const ShardedTree<int, int>& tree, size_t& count)
+{
+    bool sorted = true;
+    int prev = -1;
+    count = 0;
+    tree.forEach([&](const int& key, const int& value) {
+        sorted = sorted && key > prev && value == key * 2;
+        prev = key;
+        ++count;
+    });
+    return sorted;
+}
+
+void test1(const char* msg)
+{
+    ShardedTree<int, int> tree(boundaries());
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(thread([&tree, t] {
+            for (int i = t; i < 4000; i += 4) {
+                tree.insert(make_pair(i, i * 2));
+            }
+            for (int i = t; i < 4000; i += 8) {
+                tree.erase(i);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    size_t count;
+    bool sorted = inOrder(tree, count);
+    cout << msg << ": " << (sorted && count == 2000 && tree.size() == 2000) << endl;
+}
+
+void test2(const char* msg)
+{
+    ShardedTree<int, int> tree(boundaries());
+    for (int i = 0; i < 4000; i += 3) {
+        tree.insert(make_pair(i, i * 2));
+    }
+    vector<int> keys;
+    tree.rangeScan(995, 2010, [&](const int& key, const int&) { keys.push_back(key); });
+    bool ok = !keys.empty() && keys.front() == 996 && keys.back() == 2007 && keys.size() == 338;
+    int value = 0;
+    ok = ok && tree.find(999, value) && value == 1998 && !tree.find(1000, value);
+    cout << msg << ": " << ok << endl;
+}
+
+void test3(const char* msg)
+{
+    ShardedTree<int, int> tree(boundaries());
+    for (int i = 0; i < 900; ++i) {
+        tree.insert(make_pair(i, i * 2));
+    }
+    double before = tree.skew();
+    bool rebalanced = tree.rebalanceIfSkewed(1.5);
+    size_t count;
+    bool sorted = inOrder(tree, count);
+    cout << msg << ": " << (before == 4.0 && rebalanced && tree.skew() == 1.0 && sorted && count == 900) << endl;
+}
+
+void test4(const char* msg)
+{
+    // rebalances racing with writers, lookups and scans lose nothing and repeat nothing
+    ShardedTree<int, int> tree(boundaries());
+    atomic<bool> done(false);
+    atomic<bool> ok(true);
+    vector<thread> threads;
+    for (int t = 0; t < 3; ++t) {
+        threads.push_back(thread([&tree, &ok, t] {
+            for (int i = t; i < 30000; i += 3) {
+                tree.insert(make_pair(i, i * 2));
+                int value = 0;
+                if (!tree.find(i, value) || value != i * 2) {
+                    ok = false;
+                }
+                if (i % 2 == 1) {
+                    tree.erase(i);
+                }
+                if (i % 300 == 0) {
+                    this_thread::yield();
+                }
+            }
+        }));
+    }
+    thread scanner([&] {
+        while (!done) {
+            size_t count;
+            if (!inOrder(tree, count) || tree.size() > 15003) {
+                ok = false;
+            }
+        }
+    });
+    thread rebalancer([&] {
+        while (!done) {
+            tree.rebalance();
+            this_thread::yield();
+        }
+    });
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    done = true;
+    scanner.join();
+    rebalancer.join();
+    size_t count;
+    bool sorted = inOrder(tree, count);
+    int value = 0;
+    bool found = tree.find(29998, value) && value == 59996 && !tree.find(29999, value);
+    cout << msg << ": " << (ok && sorted && count == 15000 && tree.size() == 15000 && found) << endl;
+}
+
+// A key that counts its live copies, to see boundary tables being freed.
+struct CountedKey
+{
+    static atomic<long> live;
+    int value;
+
+    CountedKey(int v = 0) : value(v) { ++live; }
+    CountedKey(const CountedKey& other) : value(other.value) { ++live; }
+    ~CountedKey() { --live; }
+    CountedKey& operator=(const CountedKey& other) { value = other.value; return *this; }
+    bool operator<(const CountedKey& other) const { return value < other.value; }
+    bool operator==(const CountedKey& other) const { return value == other.value; }
+};
+
+atomic<long> CountedKey::live(0);
+
+void test5(const char* msg)
+{
+    // replaced boundary tables are freed, so repeated rebalancing does not grow memory
+    vector<CountedKey> bounds;
+    for (int i = 1; i < 16; ++i) {
+        bounds.push_back(CountedKey(i * 100));
+    }
+    ShardedTree<CountedKey, int> tree(bounds);
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(make_pair(CountedKey(i), i));
+    }
+    long before = CountedKey::live;
+    for (int round = 0; round < 2000; ++round) {
+        tree.insert(make_pair(CountedKey(round % 1000), round));
+        tree.rebalance();
+    }
+    int value = 0;
+    bool found = tree.find(CountedKey(999), value) && value == 1999;
+    // the reclaimer may hold a few hundred retired tables of 15 keys each; leaking
+    // every one would leave 30000
+    cout << msg << ": " << (found && tree.size() == 1000 && CountedKey::live - before < 5000) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+    test4("Test4");
+    test5("Test5");
+}
@@ -0,0 +1,422 @@
+#ifndef SHARDED_TREE_H
+#define SHARDED_TREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+#include "concurrent-avl.h"
+
+/**
+* A thread-safe ordered map that partitions the key space into ranges, each held in its
+* own AVLTree behind its own reader-writer lock. Shard i holds the keys k with
+* boundaries[i-1] <= k < boundaries[i], so operations on different ranges run in
+* parallel and readers of the same range share their lock.
+*
+* The boundaries live in an immutable table published through an atomic pointer, so an
+* operation shares no lock or counter with operations on other shards: it reads the
+* table, locks the shard it names, then checks that the table is still current, retrying
+* if rebalance() replaced it meanwhile. rebalance() swaps the table while it holds every
+* shard lock. Readers stay inside an EpochReclaimer::Guard while they use a table, and a
+* replaced one is retired to the process-wide EpochReclaimer, which frees it once no
+* reader can still hold it.
+*/
+template <class Key, class Value>
+class ShardedTree
+{
+public:
+    // Creates boundaries.size() + 1 shards split at the given (sorted) keys.
+    explicit ShardedTree(const std::vector<Key>& boundaries);
+    ~ShardedTree();
+
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void erase(const Key& key);
+    // Copies the value for key into value. Returns false if key is not present.
+    bool find(const Key& key, Value& value) const;
+    size_t size() const;
+    size_t shardCount() const;
+
+    // Calls fn(key, value) for every item in key order. Each shard is visited under its
+    // own read lock, so the pass is consistent per shard but not across shards.
+    template <typename Fn>
+    void forEach(Fn fn) const;
+    // Calls fn(key, value) in key order for every item with lo <= key < hi.
+    template <typename Fn>
+    void rangeScan(const Key& lo, const Key& hi, Fn fn) const;
+
+    // Ratio of the largest shard's size to the mean shard size (1.0 is perfectly even).
+    double skew() const;
+    // Redistributes the items so every shard holds the same number of keys.
+    void rebalance();
+    // Rebalances only if skew() exceeds maxSkew. Returns true if it did.
+    bool rebalanceIfSkewed(double maxSkew);
+
+private:
+    struct Shard
+    {
+        mutable std::shared_mutex lock;
+        AVLTree<Key, Value> tree;
+        std::atomic<size_t> count;
+
+        Shard() : count(0) {}
+    };
+
+    static size_t shardFor(const std::vector<Key>& boundaries, const Key& key);
+    static void deleteBoundaries(void* boundaries);
+    // Locks, with guard, the shard holding key (the first shard if key is NULL) under
+    // the current boundaries. Returns its index, and the boundaries if asked. The caller
+    // must be inside an EpochReclaimer::Guard.
+    template <typename Lock>
+    size_t lockShard(const Key* key, Lock& guard, const std::vector<Key>** boundaries = NULL) const;
+    // Ordered traversal of the items with *lo <= key < *hi; NULL means unbounded.
+    template <typename Fn>
+    void scan(const Key* lo, const Key* hi, Fn& fn) const;
+    template <typename Fn>
+    void scanShard(const AVLTree<Key, Value>& tree, const Key* lo, const Key* hi, Fn& fn) const;
+    // Sums the shard counts and finds the largest.
+    size_t countItems(size_t& largest) const;
+
+    std::atomic<const std::vector<Key>*> mBoundaries;
+    std::vector<std::unique_ptr<Shard>> mShards;
+    // Serializes rebalance().
+    std::mutex mRebalanceLock;
+    // Odd while rebalance() rewrites the shard counts.
+    std::atomic<size_t> mCountVersion;
+};
+
+/*
+------------------------------------------------
+Begin implementations for the ShardedTree class.
+------------------------------------------------
+*/
+
+/**
+* Constructor. The boundaries must be sorted.
+*/
+template<typename Key, typename Value>
+ShardedTree<Key, Value>::ShardedTree(const std::vector<Key>& boundaries)
+    : mBoundaries(new std::vector<Key>(boundaries))
+    , mCountVersion(0)
+{
+    for (size_t i = 0; i <= boundaries.size(); ++i) {
+        mShards.emplace_back(new Shard);
+    }
+}
+
+/**
+* Destructor. Tables replaced earlier are the reclaimer's to free.
+*/
+template<typename Key, typename Value>
+ShardedTree<Key, Value>::~ShardedTree()
+{
+    delete mBoundaries.load();
+}
+
+/**
+* Returns the index of the shard whose range contains key.
+*/
+template<typename Key, typename Value>
+size_t ShardedTree<Key, Value>::shardFor(const std::vector<Key>& boundaries, const Key& key)
+{
+    return std::upper_bound(boundaries.begin(), boundaries.end(), key) - boundaries.begin();
+}
+
+/**
+* Deleter for a retired boundary table.
+*/
+template<typename Key, typename Value>
+void ShardedTree<Key, Value>::deleteBoundaries(void* boundaries)
+{
+    delete static_cast<std::vector<Key>*>(boundaries);
+}
+
+/**
+* Reads the table, locks the shard it names and checks the table again. rebalance()
+* publishes a new table only while it holds every shard lock, so if the table is
+* unchanged once the lock is held, it stays current until the lock is released. The
+* caller's guard keeps a replaced table from being freed, and so its address from being
+* reused, so comparing pointers is enough.
+*/
+template<typename Key, typename Value>
+template<typename Lock>
+size_t ShardedTree<Key, Value>::lockShard(const Key* key, Lock& guard, const std::vector<Key>** boundaries) const
+{
+    for (;;) {
+        const std::vector<Key>* table = mBoundaries.load(std::memory_order_acquire);
+        size_t index = (key != NULL) ? shardFor(*table, *key) : 0;
+        guard = Lock(mShards[index]->lock);
+        if (mBoundaries.load(std::memory_order_acquire) == table) {
+            if (boundaries != NULL) {
+                *boundaries = table;
+            }
+            return index;
+        }
+        guard.unlock();
+    }
+}
+
+/**
+* Inserts or updates an item under the owning shard's write lock. The shard's count is
+* refreshed from the tree's own size, so the write is a single descent.
+*/
+template<typename Key, typename Value>
+void ShardedTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    EpochReclaimer::Guard epoch;
+    std::unique_lock<std::shared_mutex> guard;
+    Shard& shard = *mShards[lockShard(&keyValuePair.first, guard)];
+    shard.tree.insert(keyValuePair);
+    shard.count.store(shard.tree.size(), std::memory_order_relaxed);
+}
+
+/**
+* Removes key, if present, under the owning shard's write lock.
+*/
+template<typename Key, typename Value>
+void ShardedTree<Key, Value>::erase(const Key& key)
+{
+    EpochReclaimer::Guard epoch;
+    std::unique_lock<std::shared_mutex> guard;
+    Shard& shard = *mShards[lockShard(&key, guard)];
+    shard.tree.erase(key);
+    shard.count.store(shard.tree.size(), std::memory_order_relaxed);
+}
+
+/**
+* Looks up key under the owning shard's read lock. The value is copied out because an
+* iterator would not stay valid once the lock is released.
+*/
+template<typename Key, typename Value>
+bool ShardedTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    EpochReclaimer::Guard epoch;
+    std::shared_lock<std::shared_mutex> guard;
+    const Shard& shard = *mShards[lockShard(&key, guard)];
+    typename AVLTree<Key, Value>::iterator it = shard.tree.find(key);
+    if (it == shard.tree.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+/**
+* Returns the number of items. Concurrent writers may make this momentarily stale.
+*/
+template<typename Key, typename Value>
+size_t ShardedTree<Key, Value>::size() const
+{
+    size_t largest;
+    return countItems(largest);
+}
+
+/**
+* Returns the number of shards.
+*/
+template<typename Key, typename Value>
+size_t ShardedTree<Key, Value>::shardCount() const
+{
+    return mShards.size();
+}
+
+/**
+* Visits the items of one shard in order, starting at *lo (or the first item) and stopping
+* before *hi (or after the last item). The caller holds the shard's lock.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void ShardedTree<Key, Value>::scanShard(const AVLTree<Key, Value>& tree, const Key* lo, const Key* hi, Fn& fn) const
+{
+    typename AVLTree<Key, Value>::iterator it = (lo != NULL) ? tree.lowerBound(*lo) : tree.begin();
+    for (; it != tree.end(); ++it) {
+        if (hi != NULL && !(it->first < *hi)) {
+            break;
+        }
+        fn(it->first, it->second);
+    }
+}
+
+/**
+* Scans one shard at a time, each under its own read lock. The next shard is found from
+* where the last one's range ended rather than by index, so a rebalance() between two
+* shards neither skips nor repeats a key: the pass resumes at the same key under the new
+* boundaries. That key lives in an older table, which the epoch guard keeps alive for
+* the whole pass.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void ShardedTree<Key, Value>::scan(const Key* lo, const Key* hi, Fn& fn) const
+{
+    EpochReclaimer::Guard epoch;
+    const Key* from = lo;
+    for (;;) {
+        std::shared_lock<std::shared_mutex> guard;
+        const std::vector<Key>* boundaries;
+        size_t index = lockShard(from, guard, &boundaries);
+        scanShard(mShards[index]->tree, from, hi, fn);
+        if (index == boundaries->size()) {
+            return;
+        }
+        from = &(*boundaries)[index];
+        if (hi != NULL && !(*from < *hi)) {
+            return;
+        }
+    }
+}
+
+/**
+* Ordered traversal of every shard.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void ShardedTree<Key, Value>::forEach(Fn fn) const
+{
+    scan(NULL, NULL, fn);
+}
+
+/**
+* Ordered traversal of [lo, hi), touching only the shards that overlap the range.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void ShardedTree<Key, Value>::rangeScan(const Key& lo, const Key& hi, Fn fn) const
+{
+    if (!(lo < hi)) {
+        return;
+    }
+    scan(&lo, &hi, fn);
+}
+
+/**
+* A seqlock read: rebalance() moves items between shards and rewrites every count, so
+* this retries until it has read them all outside such a rewrite.
+*/
+template<typename Key, typename Value>
+size_t ShardedTree<Key, Value>::countItems(size_t& largest) const
+{
+    for (;;) {
+        size_t version = mCountVersion.load(std::memory_order_acquire);
+        if (version % 2 == 0) {
+            size_t total = 0;
+            largest = 0;
+            for (size_t i = 0; i < mShards.size(); ++i) {
+                size_t count = mShards[i]->count.load(std::memory_order_relaxed);
+                total += count;
+                largest = std::max(largest, count);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (mCountVersion.load(std::memory_order_relaxed) == version) {
+                return total;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+/**
+* Compares the largest shard to the average.
+*/
+template<typename Key, typename Value>
+double ShardedTree<Key, Value>::skew() const
+{
+    size_t largest;
+    size_t total = countItems(largest);
+    if (total == 0) {
+        return 1.0;
+    }
+    return (double)largest * mShards.size() / total;
+}
+
+/**
+* Drains every shard in key order, picks new boundaries at equal-count split points,
+* publishes them as a new table and refills the shards. Holds every shard lock (taken in
+* index order), so it waits for in-flight operations to finish and blocks new ones until
+* it is done; they then find the table replaced and retry. The drained items are sorted,
+* so each shard is rebuilt from its slice by assignSorted. The shard counts are left
+* alone until the end, then rewritten inside a seqlock write. O(n).
+*/
+template<typename Key, typename Value>
+void ShardedTree<Key, Value>::rebalance()
+{
+    std::lock_guard<std::mutex> rebalancing(mRebalanceLock);
+    std::vector<std::unique_lock<std::shared_mutex>> guards;
+    guards.reserve(mShards.size());
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        guards.emplace_back(mShards[i]->lock);
+    }
+
+    std::vector<std::pair<Key, Value>> items;
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        AVLTree<Key, Value>& tree = mShards[i]->tree;
+        for (typename AVLTree<Key, Value>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            items.push_back(*it);
+        }
+        tree.clear();
+    }
+    if (items.empty()) {
+        return;
+    }
+
+    // boundaries must stay distinct, so with fewer items than shards some shards stay empty
+    size_t shards = mShards.size();
+    std::vector<Key> boundaries;
+    for (size_t i = 1; i < shards; ++i) {
+        size_t split = items.size() * i / shards;
+        if (split == 0 || (!boundaries.empty() && !(boundaries.back() < items[split].first))) {
+            continue;
+        }
+        boundaries.push_back(items[split].first);
+    }
+    while (boundaries.size() + 1 < shards) {
+        // pad with the largest key; the trailing shards stay empty
+        boundaries.push_back(boundaries.empty() ? items.back().first : boundaries.back());
+    }
+    const std::vector<Key>* replaced = mBoundaries.load(std::memory_order_relaxed);
+    mBoundaries.store(new std::vector<Key>(boundaries), std::memory_order_release);
+    EpochReclaimer::instance().retire(const_cast<std::vector<Key>*>(replaced), &deleteBoundaries);
+
+    size_t first = 0;
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        size_t last = items.size();
+        if (i < boundaries.size()) {
+            last = std::lower_bound(items.begin() + first, items.end(), boundaries[i],
+                [](const std::pair<Key, Value>& item, const Key& key) { return item.first < key; }) - items.begin();
+        }
+        mShards[i]->tree.assignSorted(items.begin() + first, items.begin() + last);
+        first = last;
+    }
+    size_t version = mCountVersion.load(std::memory_order_relaxed);
+    mCountVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < mShards.size(); ++i) {
+        mShards[i]->count.store(mShards[i]->tree.size(), std::memory_order_relaxed);
+    }
+    mCountVersion.store(version + 2, std::memory_order_release);
+}
+
+/**
+* Rebalances when the largest shard holds more than maxSkew times its fair share.
+*/
+template<typename Key, typename Value>
+bool ShardedTree<Key, Value>::rebalanceIfSkewed(double maxSkew)
+{
+    if (skew() <= maxSkew) {
+        return false;
+    }
+    rebalance();
+    return true;
+}
+
+/*
+----------------------------------------------
+End implementations for the ShardedTree class.
+----------------------------------------------
+*/
+
+#endif
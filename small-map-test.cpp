@@ -0,0 +1,62 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include "small-map.h"
+#include "test-items.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    // inline inserts stay sorted, updates replace, and erase closes the gap
+    SmallMap<int, string, 4> map;
+    std::map<int, string> expected;
+    int keys[] = {30, 10, 40, 20};
+    for (int i = 0; i < 4; ++i) {
+        map.insert(make_pair(keys[i], to_string(keys[i])));
+        expected[keys[i]] = to_string(keys[i]);
+    }
+    map.insert(make_pair(10, string("ten")));
+    expected[10] = "ten";
+    bool ok = map.isSmall() && map.size() == expected.size() && sameItems(map, expected) && map.find(10)->second == "ten";
+    ok = ok && map.find(15) == map.end() && map.find(50) == map.end();
+    map.erase(20);
+    map.erase(25);
+    expected.erase(20);
+    cout << msg << ": " << (ok && map.isSmall() && map.size() == expected.size() && sameItems(map, expected)) << endl;
+}
+
+void test2(const char* msg)
+{
+    // grows into a tree and shrinks back, matching std::map throughout
+    SmallMap<int, string, 8> map;
+    std::map<int, string> expected;
+    mt19937 rng(47);
+    bool ok = true;
+    bool promoted = false, demoted = false;
+    for (int i = 0; i < 5000; ++i) {
+        int key = rng() % 24;
+        bool wasSmall = map.isSmall();
+        if (rng() % 2 == 0) {
+            map.erase(key);
+            expected.erase(key);
+        }
+        else {
+            map.insert(make_pair(key, to_string(i)));
+            expected[key] = to_string(i);
+        }
+        promoted = promoted || (wasSmall && !map.isSmall());
+        demoted = demoted || (!wasSmall && map.isSmall());
+        ok = ok && map.size() == expected.size() && sameItems(map, expected) && (map.isSmall() ? map.size() <= 8 : map.size() > 4);
+        ok = ok && (map.find(key) != map.end()) == (expected.count(key) == 1);
+    }
+    map.clear();
+    cout << msg << ": " << (ok && promoted && demoted && map.empty() && map.isSmall()) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+}
@@ -0,0 +1,380 @@
+#ifndef SMALL_MAP_H
+#define SMALL_MAP_H
+
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* A map for mostly tiny sizes. Up to N items live in a sorted array inside the object
+* itself, searched by binary search, so a small map costs no allocation at all. The
+* insert that would make it N + 1 items promotes it to an AVLTree, built in one pass
+* from the sorted array. An erase that leaves the tree with N / 2 items demotes it back;
+* the gap between the two thresholds keeps a map near the boundary from switching on
+* every operation.
+*
+* Both forms share one iterator type, which visits items in key order. Inserting or
+* erasing invalidates iterators. A SmallMap cannot be copied.
+*/
+template <typename Key, typename Value, size_t N = 16>
+class SmallMap
+{
+public:
+    class iterator
+    {
+    public:
+        iterator();
+        std::pair<Key, Value>& operator*() const;
+        std::pair<Key, Value>* operator->() const;
+        iterator& operator++();
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+    private:
+        friend class SmallMap<Key, Value, N>;
+
+        // Exactly one of the two is in use, depending on mInTree.
+        std::pair<Key, Value>* mItem;
+        typename AVLTree<Key, Value>::iterator mTreeIt;
+        bool mInTree;
+    };
+
+    SmallMap();
+    ~SmallMap();
+
+    // Adds the item, or replaces the value of an existing key.
+    void insert(const std::pair<Key, Value>& keyValuePair);
+    void erase(const Key& key);
+    void clear();
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+
+    size_t size() const;
+    bool empty() const;
+    // True while the items are held inline.
+    bool isSmall() const { return mTree == NULL; }
+
+private:
+    SmallMap(const SmallMap&);
+    SmallMap& operator=(const SmallMap&);
+
+    std::pair<Key, Value>* items() const;
+    // First inline item whose key is not less than key.
+    std::pair<Key, Value>* lowerBound(const Key& key) const;
+    void promote(const std::pair<Key, Value>& keyValuePair);
+    void demote();
+    void destroyItems();
+
+    alignas(std::pair<Key, Value>) unsigned char mStorage[N * sizeof(std::pair<Key, Value>)];
+    size_t mCount;
+    // The tree form, or NULL while small.
+    AVLTree<Key, Value>* mTree;
+};
+
+/*
+-------------------------------------------------------
+Begin implementations for the SmallMap::iterator class.
+-------------------------------------------------------
+*/
+
+template<typename Key, typename Value, size_t N>
+SmallMap<Key, Value, N>::iterator::iterator()
+    : mItem(NULL), mInTree(false)
+{
+
+}
+
+template<typename Key, typename Value, size_t N>
+std::pair<Key, Value>& SmallMap<Key, Value, N>::iterator::operator*() const
+{
+    if (mInTree) {
+        typename AVLTree<Key, Value>::iterator it = mTreeIt;
+        return *it;
+    }
+    return *mItem;
+}
+
+template<typename Key, typename Value, size_t N>
+std::pair<Key, Value>* SmallMap<Key, Value, N>::iterator::operator->() const
+{
+    return &(**this);
+}
+
+template<typename Key, typename Value, size_t N>
+typename SmallMap<Key, Value, N>::iterator& SmallMap<Key, Value, N>::iterator::operator++()
+{
+    if (mInTree) {
+        ++mTreeIt;
+    }
+    else {
+        ++mItem;
+    }
+    return *this;
+}
+
+template<typename Key, typename Value, size_t N>
+bool SmallMap<Key, Value, N>::iterator::operator==(const iterator& rhs) const
+{
+    return mInTree == rhs.mInTree && (mInTree ? mTreeIt == rhs.mTreeIt : mItem == rhs.mItem);
+}
+
+template<typename Key, typename Value, size_t N>
+bool SmallMap<Key, Value, N>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/*
+-----------------------------------------------------
+End implementations for the SmallMap::iterator class.
+-----------------------------------------------------
+*/
+
+/*
+---------------------------------------------
+Begin implementations for the SmallMap class.
+---------------------------------------------
+*/
+
+/**
+* Constructor. A new map is small and empty.
+*/
+template<typename Key, typename Value, size_t N>
+SmallMap<Key, Value, N>::SmallMap()
+    : mCount(0), mTree(NULL)
+{
+
+}
+
+/**
+* Destructor.
+*/
+template<typename Key, typename Value, size_t N>
+SmallMap<Key, Value, N>::~SmallMap()
+{
+    clear();
+}
+
+/**
+* Inserts into the sorted array by shifting the larger items up one place, or promotes
+* if the array is full.
+*/
+template<typename Key, typename Value, size_t N>
+void SmallMap<Key, Value, N>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+    if (mTree != NULL) {
+        mTree->insert(keyValuePair);
+        return;
+    }
+    std::pair<Key, Value>* position = lowerBound(keyValuePair.first);
+    std::pair<Key, Value>* end = items() + mCount;
+    if (position != end && !(keyValuePair.first < position->first)) {
+        position->second = keyValuePair.second;
+        return;
+    }
+    if (mCount == N) {
+        promote(keyValuePair);
+        return;
+    }
+    if (position == end) {
+        new (end) std::pair<Key, Value>(keyValuePair);
+    }
+    else {
+        new (end) std::pair<Key, Value>(std::move(end[-1]));
+        std::move_backward(position, end - 1, end);
+        *position = keyValuePair;
+    }
+    ++mCount;
+}
+
+/**
+* Removes key, if present, closing the gap in the array or demoting a tree that has
+* shrunk to N / 2 items.
+*/
+template<typename Key, typename Value, size_t N>
+void SmallMap<Key, Value, N>::erase(const Key& key)
+{
+    if (mTree != NULL) {
+        mTree->erase(key);
+        if (mTree->size() <= N / 2) {
+            demote();
+        }
+        return;
+    }
+    std::pair<Key, Value>* position = lowerBound(key);
+    std::pair<Key, Value>* end = items() + mCount;
+    if (position == end || key < position->first) {
+        return;
+    }
+    std::move(position + 1, end, position);
+    end[-1].~pair();
+    --mCount;
+}
+
+/**
+* Removes every item, returning to the small form.
+*/
+template<typename Key, typename Value, size_t N>
+void SmallMap<Key, Value, N>::clear()
+{
+    delete mTree;
+    mTree = NULL;
+    destroyItems();
+}
+
+/**
+* Iterator to the smallest item.
+*/
+template<typename Key, typename Value, size_t N>
+typename SmallMap<Key, Value, N>::iterator SmallMap<Key, Value, N>::begin() const
+{
+    iterator it;
+    if (mTree != NULL) {
+        it.mInTree = true;
+        it.mTreeIt = mTree->begin();
+    }
+    else {
+        it.mItem = items();
+    }
+    return it;
+}
+
+/**
+* Iterator past the largest item.
+*/
+template<typename Key, typename Value, size_t N>
+typename SmallMap<Key, Value, N>::iterator SmallMap<Key, Value, N>::end() const
+{
+    iterator it;
+    if (mTree != NULL) {
+        it.mInTree = true;
+        it.mTreeIt = mTree->end();
+    }
+    else {
+        it.mItem = items() + mCount;
+    }
+    return it;
+}
+
+/**
+* Binary search of the array, or a tree lookup.
+*/
+template<typename Key, typename Value, size_t N>
+typename SmallMap<Key, Value, N>::iterator SmallMap<Key, Value, N>::find(const Key& key) const
+{
+    if (mTree != NULL) {
+        iterator it;
+        it.mInTree = true;
+        it.mTreeIt = mTree->find(key);
+        return it;
+    }
+    std::pair<Key, Value>* position = lowerBound(key);
+    if (position == items() + mCount || key < position->first) {
+        return end();
+    }
+    iterator it;
+    it.mItem = position;
+    return it;
+}
+
+template<typename Key, typename Value, size_t N>
+size_t SmallMap<Key, Value, N>::size() const
+{
+    return (mTree != NULL) ? mTree->size() : mCount;
+}
+
+template<typename Key, typename Value, size_t N>
+bool SmallMap<Key, Value, N>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* The inline array.
+*/
+template<typename Key, typename Value, size_t N>
+std::pair<Key, Value>* SmallMap<Key, Value, N>::items() const
+{
+    return std::launder(reinterpret_cast<std::pair<Key, Value>*>(const_cast<unsigned char*>(mStorage)));
+}
+
+template<typename Key, typename Value, size_t N>
+std::pair<Key, Value>* SmallMap<Key, Value, N>::lowerBound(const Key& key) const
+{
+    std::pair<Key, Value>* lo = items();
+    size_t count = mCount;
+    while (count > 0) {
+        size_t half = count / 2;
+        if (lo[half].first < key) {
+            lo += half + 1;
+            count -= half + 1;
+        }
+        else {
+            count = half;
+        }
+    }
+    return lo;
+}
+
+/**
+* Moves to the tree form. The tree is built from the full array and the new item added
+* before the array is released, so if anything throws the map is unchanged.
+*/
+template<typename Key, typename Value, size_t N>
+void SmallMap<Key, Value, N>::promote(const std::pair<Key, Value>& keyValuePair)
+{
+    AVLTree<Key, Value>* tree = new AVLTree<Key, Value>();
+    try {
+        tree->assignSorted(items(), items() + mCount);
+        tree->insert(keyValuePair);
+    }
+    catch (...) {
+        delete tree;
+        throw;
+    }
+    destroyItems();
+    mTree = tree;
+}
+
+/**
+* Moves the remaining items back into the array and frees the tree.
+*/
+template<typename Key, typename Value, size_t N>
+void SmallMap<Key, Value, N>::demote()
+{
+    std::pair<Key, Value>* array = items();
+    try {
+        for (typename AVLTree<Key, Value>::iterator it = mTree->begin(); it != mTree->end(); ++it) {
+            new (array + mCount) std::pair<Key, Value>(*it);
+            ++mCount;
+        }
+    }
+    catch (...) {
+        destroyItems();
+        throw;
+    }
+    delete mTree;
+    mTree = NULL;
+}
+
+template<typename Key, typename Value, size_t N>
+void SmallMap<Key, Value, N>::destroyItems()
+{
+    std::pair<Key, Value>* array = items();
+    for (size_t i = 0; i < mCount; ++i) {
+        array[i].~pair();
+    }
+    mCount = 0;
+}
+
+/*
+-------------------------------------------
+End implementations for the SmallMap class.
+-------------------------------------------
+*/
+
+#endif
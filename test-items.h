@@ -0,0 +1,35 @@
+#ifndef TEST_ITEMS_H
+#define TEST_ITEMS_H
+
+/**
+* Comparison helpers shared by the *-test.cpp programs, which check a tree or map
+* against a std::map holding the items it should have.
+*/
+
+/**
+* True if iterating range (anything with begin() and end() over key/value pairs) visits
+* exactly the items of expected, in the same order.
+*/
+template <typename Range, typename Expected>
+bool sameItems(const Range& range, const Expected& expected)
+{
+    typename Expected::const_iterator want = expected.begin();
+    for (auto it = range.begin(); it != range.end(); ++it, ++want) {
+        if (want == expected.end() || it->first != want->first || it->second != want->second) {
+            return false;
+        }
+    }
+    return want == expected.end();
+}
+
+/**
+* True if tree passes a full validate(), counts the items of expected and holds exactly
+* those items.
+*/
+template <typename Tree, typename Expected>
+bool treeMatches(Tree& tree, const Expected& expected)
+{
+    return tree.validate() && tree.size() == expected.size() && sameItems(tree, expected);
+}
+
+#endif
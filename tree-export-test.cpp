@@ -0,0 +1,169 @@
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "avlbst.h"
+#include "tree-export.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    AVLTree<int, string> tree;
+    tree.insert(make_pair(2, string("two")));
+    tree.insert(make_pair(1, string("say \"one\"")));
+    tree.insert(make_pair(3, string("three")));
+    ostringstream out;
+    exportDot(tree, out);
+    string expected =
+        "digraph BST {\n"
+        "    node [shape=box];\n"
+        "    n1 [label=\"2: two\"];\n"
+        "    n2 [label=\"1: say \\\"one\\\"\"];\n"
+        "    n1 -> n2;\n"
+        "    n3 [label=\"3: three\"];\n"
+        "    n1 -> n3;\n"
+        "}\n";
+    cout << msg << ": " << (out.str() == expected) << endl;
+}
+
+void test2(const char* msg)
+{
+    AVLTree<char, double> tree;
+    tree.insert(make_pair('b', 2.5));
+    tree.insert(make_pair('a', -1.0));
+    ostringstream out;
+    exportJson(tree, out);
+    AVLTree<int, int> empty;
+    ostringstream none;
+    exportJson(empty, none);
+    cout << msg << ": " << (out.str() == "{\"key\":\"b\",\"value\":2.5,\"left\":{\"key\":\"a\",\"value\":-1,\"left\":null,\"right\":null},\"right\":null}\n"
+            && none.str() == "null\n") << endl;
+}
+
+void test3(const char* msg)
+{
+    // a tree much larger than the buffer, written through a file descriptor
+    AVLTree<int, int> tree;
+    const int n = 200000;
+    for (int i = 0; i < n; ++i) {
+        tree.insert(make_pair(i, i * 2));
+    }
+    FILE* file = tmpfile();
+    exportDot(tree, fileno(file));
+    rewind(file);
+    size_t lines = 0, edges = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ++lines;
+        if (string(line).find("->") != string::npos) {
+            ++edges;
+        }
+    }
+    fclose(file);
+    cout << msg << ": " << (edges == (size_t)n - 1 && lines == 2 * (size_t)n + 2) << endl;
+}
+
+void test4(const char* msg)
+{
+    // tombstones keep their place in the shape but are marked
+    AVLTree<int, int> tree;
+    tree.setLazyErase(0.9);
+    tree.insert(make_pair(2, 2));
+    tree.insert(make_pair(1, 1));
+    tree.insert(make_pair(3, 3));
+    tree.erase(1);
+    ostringstream dot, json;
+    exportDot(tree, dot);
+    exportJson(tree, json);
+    string expectedDot =
+        "digraph BST {\n"
+        "    node [shape=box];\n"
+        "    n1 [label=\"2: 2\"];\n"
+        "    n2 [label=\"1: 1\", style=dashed];\n"
+        "    n1 -> n2;\n"
+        "    n3 [label=\"3: 3\"];\n"
+        "    n1 -> n3;\n"
+        "}\n";
+    string expectedJson = "{\"key\":2,\"value\":2,\"left\":{\"key\":1,\"value\":1,\"erased\":true,\"left\":null,\"right\":null},"
+        "\"right\":{\"key\":3,\"value\":3,\"left\":null,\"right\":null}}\n";
+    cout << msg << ": " << (tree.size() == 2 && dot.str() == expectedDot && json.str() == expectedJson) << endl;
+}
+
+void test5(const char* msg)
+{
+    // values below a pending range update are exported with the update applied
+    AVLTree<int, long, RangeAddAggregate<long> > tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, 0L));
+    }
+    tree.updateRange(0, 99, 5L);
+    ostringstream dot;
+    exportDot(tree, dot);
+    tree.updateRange(0, 99, 1L);
+    ostringstream json;
+    exportJson(tree, json);
+    size_t dotValues = 0, jsonValues = 0;
+    for (size_t at = dot.str().find(": 5\""); at != string::npos; at = dot.str().find(": 5\"", at + 1)) {
+        ++dotValues;
+    }
+    for (size_t at = json.str().find("\"value\":6,"); at != string::npos; at = json.str().find("\"value\":6,", at + 1)) {
+        ++jsonValues;
+    }
+    cout << msg << ": " << (dotValues == 100 && jsonValues == 100) << endl;
+}
+
+void test6(const char* msg)
+{
+    // control characters are escaped, not dropped
+    AVLTree<string, int> tree;
+    tree.insert(make_pair(string("a\tb\r\n") + '\0' + "\x1f", 1));
+    ostringstream json;
+    exportJson(tree, json);
+    cout << msg << ": " << (json.str() == "{\"key\":\"a\\tb\\r\\n\\u0000\\u001f\",\"value\":1,\"left\":null,\"right\":null}\n") << endl;
+}
+
+void test7(const char* msg)
+{
+    // non-finite values are null in JSON, which has no number for them
+    AVLTree<int, double> tree;
+    tree.insert(make_pair(2, numeric_limits<double>::quiet_NaN()));
+    tree.insert(make_pair(1, -numeric_limits<double>::infinity()));
+    tree.insert(make_pair(3, 0.5));
+    ostringstream json;
+    exportJson(tree, json);
+    cout << msg << ": " << (json.str() == "{\"key\":2,\"value\":null,\"left\":{\"key\":1,\"value\":null,\"left\":null,\"right\":null},"
+            "\"right\":{\"key\":3,\"value\":0.5,\"left\":null,\"right\":null}}\n") << endl;
+}
+
+void test8(const char* msg)
+{
+    // writing to a failed stream throws instead of reporting success
+    AVLTree<int, int> tree;
+    tree.insert(make_pair(1, 1));
+    ostringstream out;
+    out.setstate(ios::badbit);
+    bool threw = false;
+    try {
+        exportJson(tree, out);
+    }
+    catch (const runtime_error&) {
+        threw = true;
+    }
+    cout << msg << ": " << threw << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+    test4("Test4");
+    test5("Test5");
+    test6("Test6");
+    test7("Test7");
+    test8("Test8");
+}
@@ -0,0 +1,380 @@
+#ifndef TREE_EXPORT_H
+#define TREE_EXPORT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <charconv>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "bst.h"
+
+/**
+* Output buffer for the exporters. Text is collected in one large block and handed to
+* the destination (a file descriptor or an ostream) only when the block fills up, so a
+* multi-million node export makes a few hundred write calls instead of one per node.
+* Write errors on a file descriptor throw std::runtime_error.
+*/
+class ExportBuffer
+{
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 20;
+
+    explicit ExportBuffer(int fd, size_t capacity = DEFAULT_CAPACITY);
+    explicit ExportBuffer(std::ostream& out, size_t capacity = DEFAULT_CAPACITY);
+    // Flushes whatever is left. Call flush() first to see write errors.
+    ~ExportBuffer();
+
+    void append(const char* data, size_t length);
+    void append(const char* text) { append(text, strlen(text)); }
+    void append(const std::string& text) { append(text.data(), text.size()); }
+    void append(char c);
+    // Hands the buffered text to the destination.
+    void flush();
+
+private:
+    ExportBuffer(const ExportBuffer&);
+    ExportBuffer& operator=(const ExportBuffer&);
+
+    int mFd;
+    std::ostream* mStream;
+    std::vector<char> mBuffer;
+    size_t mUsed;
+};
+
+/*
+-------------------------------------------------
+Begin implementations for the ExportBuffer class.
+-------------------------------------------------
+*/
+
+/**
+* Constructor for writing to a file descriptor, which stays owned by the caller.
+*/
+inline ExportBuffer::ExportBuffer(int fd, size_t capacity)
+    : mFd(fd)
+    , mStream(NULL)
+    , mBuffer(capacity == 0 ? 1 : capacity)
+    , mUsed(0)
+{
+
+}
+
+/**
+* Constructor for writing to a stream.
+*/
+inline ExportBuffer::ExportBuffer(std::ostream& out, size_t capacity)
+    : mFd(-1)
+    , mStream(&out)
+    , mBuffer(capacity == 0 ? 1 : capacity)
+    , mUsed(0)
+{
+
+}
+
+/**
+* Destructor. Errors cannot be reported from here, so they are dropped.
+*/
+inline ExportBuffer::~ExportBuffer()
+{
+    try {
+        flush();
+    }
+    catch (const std::exception&) {
+    }
+}
+
+/**
+* Copies data into the buffer, flushing as often as needed.
+*/
+inline void ExportBuffer::append(const char* data, size_t length)
+{
+    while (length > 0) {
+        if (mUsed == mBuffer.size()) {
+            flush();
+        }
+        size_t chunk = std::min(length, mBuffer.size() - mUsed);
+        memcpy(&mBuffer[mUsed], data, chunk);
+        mUsed += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+* Appends one character.
+*/
+inline void ExportBuffer::append(char c)
+{
+    if (mUsed == mBuffer.size()) {
+        flush();
+    }
+    mBuffer[mUsed++] = c;
+}
+
+/**
+* Writes the buffer out, retrying short writes and interrupted calls. A stream that is
+* left failed throws, as a failed write to a file descriptor does.
+*/
+inline void ExportBuffer::flush()
+{
+    if (mStream != NULL) {
+        mStream->write(&mBuffer[0], mUsed);
+        mUsed = 0;
+        if (!*mStream) {
+            throw std::runtime_error("tree export write failed: stream is in a failed state");
+        }
+        return;
+    }
+    size_t done = 0;
+    while (done < mUsed) {
+        ssize_t n = ::write(mFd, &mBuffer[done], mUsed - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            mUsed = 0;
+            throw std::runtime_error(std::string("tree export write failed: ") + strerror(errno));
+        }
+        done += n;
+    }
+    mUsed = 0;
+}
+
+/*
+-----------------------------------------------
+End implementations for the ExportBuffer class.
+-----------------------------------------------
+*/
+
+/**
+* Appends text as the inside of a quoted DOT or JSON string. Control characters are
+* escaped (\n, \t, \r, or \u00XX for the rest) rather than dropped, so the text
+* can be read back exactly.
+*/
+inline void exportEscaped(ExportBuffer& out, const char* text, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        char c = text[i];
+        if (c == '"' || c == '\\') {
+            out.append('\\');
+            out.append(c);
+        }
+        else if (c == '\n') {
+            out.append("\\n", 2);
+        }
+        else if (c == '\t') {
+            out.append("\\t", 2);
+        }
+        else if (c == '\r') {
+            out.append("\\r", 2);
+        }
+        else if ((unsigned char)c < 0x20) {
+            static const char HEX[] = "0123456789abcdef";
+            char escape[6] = { '\\', 'u', '0', '0', HEX[(c >> 4) & 0xf], HEX[c & 0xf] };
+            out.append(escape, 6);
+        }
+        else {
+            out.append(c);
+        }
+    }
+}
+
+/**
+* Appends a key or value. Numbers are formatted with to_chars and strings are copied
+* directly; any other type is formatted once through operator<<. When quoteStrings is
+* set (JSON), everything except numbers and bools is written as a quoted string, and a
+* NaN or infinity, which JSON has no number for, is written as null.
+*/
+template <typename T>
+void exportScalar(ExportBuffer& out, const T& value, bool quoteStrings)
+{
+    if constexpr (std::is_same<T, bool>::value) {
+        out.append(value ? "true" : "false");
+    }
+    else if constexpr (std::is_arithmetic<T>::value && !std::is_same<T, char>::value) {
+        if constexpr (std::is_floating_point<T>::value) {
+            if (quoteStrings && !std::isfinite(value)) {
+                out.append("null", 4);
+                return;
+            }
+        }
+        char digits[64];
+        std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr - digits);
+    }
+    else {
+        if (quoteStrings) {
+            out.append('"');
+        }
+        if constexpr (std::is_same<T, std::string>::value) {
+            exportEscaped(out, value.data(), value.size());
+        }
+        else if constexpr (std::is_same<T, char>::value) {
+            exportEscaped(out, &value, 1);
+        }
+        else {
+            std::ostringstream text;
+            text << value;
+            std::string s = text.str();
+            exportEscaped(out, s.data(), s.size());
+        }
+        if (quoteStrings) {
+            out.append('"');
+        }
+    }
+}
+
+/**
+* Writes the tree as a Graphviz digraph: one "n<i> [label=...]" line per node, numbered
+* in pre-order, and one edge line per child. Tombstones left by a lazy erase keep their
+* place in the shape but are drawn dashed. Pending range updates are flushed first. A
+* single iterative pass, O(n) time and O(height) extra memory.
+*/
+template <typename Key, typename Value, typename Allocator>
+void exportDot(const BinarySearchTree<Key, Value, Allocator>& tree, ExportBuffer& out)
+{
+    tree.flushUpdates();
+    out.append("digraph BST {\n    node [shape=box];\n");
+    // each entry is a node and the number of its parent (0 for the root)
+    std::vector<std::pair<Node<Key, Value>*, size_t> > stack;
+    if (tree.mRoot != NULL) {
+        stack.push_back(std::make_pair(tree.mRoot, (size_t)0));
+    }
+    size_t next = 0;
+    char digits[32];
+    while (!stack.empty()) {
+        Node<Key, Value>* node = stack.back().first;
+        size_t parent = stack.back().second;
+        stack.pop_back();
+        size_t id = ++next;
+        std::to_chars_result idEnd = std::to_chars(digits, digits + sizeof(digits), id);
+
+        out.append("    n", 5);
+        out.append(digits, idEnd.ptr - digits);
+        out.append(" [label=\"", 9);
+        exportScalar(out, node->getKey(), false);
+        out.append(": ", 2);
+        exportScalar(out, node->getValue(), false);
+        if (node->isErased()) {
+            out.append("\", style=dashed];\n", 18);
+        }
+        else {
+            out.append("\"];\n", 4);
+        }
+        if (parent != 0) {
+            char parentDigits[32];
+            std::to_chars_result parentEnd = std::to_chars(parentDigits, parentDigits + sizeof(parentDigits), parent);
+            out.append("    n", 5);
+            out.append(parentDigits, parentEnd.ptr - parentDigits);
+            out.append(" -> n", 5);
+            out.append(digits, idEnd.ptr - digits);
+            out.append(";\n", 2);
+        }
+
+        // right first, so the left child is numbered (and drawn) first
+        if (node->getRight() != NULL) {
+            stack.push_back(std::make_pair(node->getRight(), id));
+        }
+        if (node->getLeft() != NULL) {
+            stack.push_back(std::make_pair(node->getLeft(), id));
+        }
+    }
+    out.append("}\n", 2);
+}
+
+/**
+* Writes the tree as nested JSON objects: {"key":k,"value":v,"left":...,"right":...},
+* with null for a missing child and for an empty tree. A tombstone left by a lazy erase
+* also has "erased":true. Pending range updates are flushed first. Iterative, O(n) time
+* and O(height) extra memory.
+*/
+template <typename Key, typename Value, typename Allocator>
+void exportJson(const BinarySearchTree<Key, Value, Allocator>& tree, ExportBuffer& out)
+{
+    tree.flushUpdates();
+    if (tree.mRoot == NULL) {
+        out.append("null\n", 5);
+        return;
+    }
+    // each entry is a node and how far it has been written: 0 = not started,
+    // 1 = left child done, 2 = right child done
+    std::vector<std::pair<Node<Key, Value>*, int> > stack;
+    stack.push_back(std::make_pair(tree.mRoot, 0));
+    while (!stack.empty()) {
+        Node<Key, Value>* node = stack.back().first;
+        int stage = stack.back().second++;
+        Node<Key, Value>* child = NULL;
+        if (stage == 0) {
+            out.append("{\"key\":", 7);
+            exportScalar(out, node->getKey(), true);
+            out.append(",\"value\":", 9);
+            exportScalar(out, node->getValue(), true);
+            if (node->isErased()) {
+                out.append(",\"erased\":true", 14);
+            }
+            out.append(",\"left\":", 8);
+            child = node->getLeft();
+        }
+        else if (stage == 1) {
+            out.append(",\"right\":", 9);
+            child = node->getRight();
+        }
+        else {
+            out.append('}');
+            stack.pop_back();
+            continue;
+        }
+        if (child != NULL) {
+            stack.push_back(std::make_pair(child, 0));
+        }
+        else {
+            out.append("null", 4);
+        }
+    }
+    out.append('\n');
+}
+
+/**
+* Convenience overloads that buffer internally and write to a file descriptor or stream.
+*/
+template <typename Key, typename Value, typename Allocator>
+void exportDot(const BinarySearchTree<Key, Value, Allocator>& tree, int fd)
+{
+    ExportBuffer out(fd);
+    exportDot(tree, out);
+    out.flush();
+}
+
+template <typename Key, typename Value, typename Allocator>
+void exportDot(const BinarySearchTree<Key, Value, Allocator>& tree, std::ostream& stream)
+{
+    ExportBuffer out(stream);
+    exportDot(tree, out);
+    out.flush();
+}
+
+template <typename Key, typename Value, typename Allocator>
+void exportJson(const BinarySearchTree<Key, Value, Allocator>& tree, int fd)
+{
+    ExportBuffer out(fd);
+    exportJson(tree, out);
+    out.flush();
+}
+
+template <typename Key, typename Value, typename Allocator>
+void exportJson(const BinarySearchTree<Key, Value, Allocator>& tree, std::ostream& stream)
+{
+    ExportBuffer out(stream);
+    exportJson(tree, out);
+    out.flush();
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <string>
+#include "avlbst.h"
+
+using namespace std;
+
+void test1(const char* msg)
+{
+    AVLTree<int, int> tree;
+    for (int i = 0; i < 10000; ++i) {
+        tree.insert(make_pair((i * 7919) % 10000, i));
+    }
+    for (int i = 0; i < 10000; i += 3) {
+        tree.erase(i);
+    }
+    string error;
+    size_t count = 0;
+    bool ok = tree.validate(&error, &count) && error.empty() && count == 6666;
+    ok = ok && tree.validateSampled(100, &error);
+    AVLTree<int, int> empty;
+    ok = ok && empty.validate(NULL, &count) && count == 0 && empty.validateSampled(10);
+    cout << msg << ": " << ok << endl;
+}
+
+void test2(const char* msg)
+{
+    // swapping two keys breaks the order but no link
+    AVLTree<int, int> tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    Node<int, int>* root = tree.mRoot;
+    swap(root->getItem().first, root->getLeft()->getItem().first);
+    string error;
+    bool full = tree.validate(&error);
+    cout << msg << ": " << (!full && error == "key out of order" && !tree.validateSampled(64)) << endl;
+    swap(root->getItem().first, root->getLeft()->getItem().first);
+}
+
+void test3(const char* msg)
+{
+    AVLTree<int, int> tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    Node<int, int>* child = tree.mRoot->getRight();
+    child->setParent(NULL);
+    string error;
+    bool broken = !tree.validate(&error) && error == "child's parent link does not point back";
+    child->setParent(tree.mRoot);
+    cout << msg << ": " << (broken && tree.validate()) << endl;
+}
+
+void test4(const char* msg)
+{
+    // a wrong balance factor is caught by the full check
+    AVLTree<int, int> tree;
+    for (int i = 0; i < 100; ++i) {
+        tree.insert(make_pair(i, i));
+    }
+    AVLNode<int, int>* root = static_cast<AVLNode<int, int>*>(tree.mRoot);
+    char balance = root->getBalance();
+    root->setBalance(balance == 0 ? 1 : 0);
+    string error;
+    bool caught = !tree.validate(&error) && error == "AVL balance does not match subtree heights";
+    root->setBalance(balance);
+
+    // and a leaf with a nonzero balance by the sampled one, on every path through it
+    Node<int, int>* leaf = tree.mRoot;
+    while (leaf->getLeft() != NULL) {
+        leaf = leaf->getLeft();
+    }
+    static_cast<AVLNode<int, int>*>(leaf)->setBalance(1);
+    bool sampled = !tree.validateSampled(10000, &error);
+    static_cast<AVLNode<int, int>*>(leaf)->setBalance(0);
+    cout << msg << ": " << (caught && sampled && tree.validate()) << endl;
+}
+
+int main()
+{
+    test1("Test1");
+    test2("Test2");
+    test3("Test3");
+    test4("Test4");
+}